@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <bemenu.h>
+
+static void
+usage(FILE *out, const char *name)
+{
+    fprintf(out, "usage: %s [-0] <file>\n\n"
+                 " -0    items are separated by NUL instead of newline.\n\n"
+                 "Reads items from standard input and writes them to file as an index for bemenu --from-index.\n", name);
+}
+
+static char*
+read_stdin(size_t *out_len)
+{
+    size_t len = 0, allocated = 0;
+    char *buffer = NULL;
+
+    for (;;) {
+        /* one extra byte is left for terminating the last item */
+        if (allocated - len < 65536 + 1) {
+            const size_t grown = (allocated ? allocated * 2 : 262144);
+
+            void *tmp;
+            if (!(tmp = realloc(buffer, grown)))
+                goto fail;
+
+            buffer = tmp;
+            allocated = grown;
+        }
+
+        ssize_t n;
+        if ((n = read(STDIN_FILENO, buffer + len, allocated - len - 1)) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            goto fail;
+        }
+
+        if (n == 0)
+            break;
+
+        len += n;
+    }
+
+    *out_len = len;
+    return buffer;
+
+fail:
+    free(buffer);
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    char delimiter = '\n';
+
+    int opt;
+    while ((opt = getopt(argc, argv, "0h")) != -1) {
+        switch (opt) {
+            case '0':
+                delimiter = 0;
+                break;
+            case 'h':
+                usage(stdout, argv[0]);
+                return EXIT_SUCCESS;
+            default:
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t len;
+    char *buffer;
+    if (!(buffer = read_stdin(&len))) {
+        fprintf(stderr, "read failed\n");
+        return EXIT_FAILURE;
+    }
+
+    /* a trailing delimiter does not produce an empty item, like with bemenu */
+    if (len > 0 && buffer[len - 1] != delimiter)
+        buffer[len++] = delimiter;
+
+    uint32_t count = 0;
+    for (const char *s = buffer; (s = memchr(s, delimiter, buffer + len - s)); ++s)
+        ++count;
+
+    const char **texts;
+    if (!(texts = calloc(count + 1, sizeof(char*)))) {
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    char *s = buffer;
+    for (uint32_t i = 0; i < count; ++i) {
+        char *d = memchr(s, delimiter, buffer + len - s);
+        *d = 0;
+        texts[i] = s;
+        s = d + 1;
+    }
+
+    const bool written = bm_write_index(argv[optind], texts, count);
+
+    if (!written)
+        fprintf(stderr, "failed to write index: %s\n", argv[optind]);
+
+    free(texts);
+    free(buffer);
+    return (written ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -73,17 +73,43 @@ get_paths(const char *env, const char *default_paths, struct paths *state)
     return strip_slash(path);
 }
 
+struct names {
+    char **names;
+    uint32_t count, allocated;
+};
+
 static int
 compare(const void *a, const void *b)
 {
-    const struct bm_item *ia = *(struct bm_item**)a, *ib = *(struct bm_item**)b;
-    return strcmp(bm_item_get_text(ia), bm_item_get_text(ib));
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+static bool
+add_name(struct names *names, const char *name)
+{
+    if (names->count >= names->allocated) {
+        const uint32_t allocated = (names->allocated ? names->allocated * 2 : 1024);
+
+        void *tmp;
+        if (!(tmp = realloc(names->names, sizeof(char*) * allocated)))
+            return false;
+
+        names->names = tmp;
+        names->allocated = allocated;
+    }
+
+    char *copy;
+    if (!(copy = c_strdup(name)))
+        return false;
+
+    names->names[names->count++] = copy;
+    return true;
 }
 
 static void
-read_items_to_menu_from_dir(struct bm_menu *menu, const char *path)
+read_names_from_dir(struct names *names, const char *path)
 {
-    assert(menu && path);
+    assert(names && path);
 
     DIR *dir;
     if (!(dir = opendir(path)))
@@ -92,28 +118,12 @@ read_items_to_menu_from_dir(struct bm_menu *menu, const char *path)
     struct dirent *file;
     while ((file = readdir(dir))) {
         if (file->d_type != DT_DIR && strlen(file->d_name) && file->d_name[0] != '.') {
-            struct bm_item *item;
-            if (!(item = bm_item_new(file->d_name)))
+            if (!add_name(names, file->d_name))
                 break;
-
-            bm_menu_add_item(menu, item);
         }
     }
 
     closedir(dir);
-
-    uint32_t count;
-    struct bm_item **items = bm_menu_get_items(menu, &count);
-    qsort(items, count, sizeof(struct bm_item*), compare);
-
-    bool unique = true;
-    for (uint32_t i = 0; i + 1 < count; i += unique) {
-        if (!(unique = strcmp(bm_item_get_text(items[i]), bm_item_get_text(items[i + 1])))) {
-            bm_item_free(items[i]);
-            bm_menu_remove_item_at(menu, i);
-            items = bm_menu_get_items(menu, &count);
-        }
-    }
 }
 
 static void
@@ -121,11 +131,33 @@ read_items_to_menu_from_path(struct bm_menu *menu)
 {
     assert(menu);
 
+    struct names names = {0};
+
     const char *path;
     struct paths state;
     memset(&state, 0, sizeof(state));
     while ((path = get_paths("PATH", "/usr/bin:/usr/sbin:/usr/local/bin:/usr/local/sbin:/bin:/sbin", &state)))
-        read_items_to_menu_from_dir(menu, path);
+        read_names_from_dir(&names, path);
+
+    /* sorted and unique names front code well */
+    qsort(names.names, names.count, sizeof(char*), compare);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < names.count; ++i) {
+        if (count > 0 && !strcmp(names.names[count - 1], names.names[i])) {
+            free(names.names[i]);
+        } else {
+            names.names[count++] = names.names[i];
+        }
+    }
+
+    if (count > 0)
+        bm_menu_add_items_front_coded(menu, (const char**)names.names, count);
+
+    for (uint32_t i = 0; i < count; ++i)
+        free(names.names[i]);
+
+    free(names.names);
 }
 
 static inline void ignore_ret(int useless, ...) { (void)useless; }
@@ -185,6 +217,7 @@ main(int argc, char **argv)
 
     read_items_to_menu_from_path(menu);
     const enum bm_run_result status = run_menu(&client, menu, item_cb);
+    print_stats(&client, menu);
     bm_menu_free(menu);
     return (status == BM_RUN_RESULT_SELECTED ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -2,48 +2,268 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "common/common.h"
 
 static struct client client = {
     .filter_mode = BM_FILTER_MODE_DMENU,
     .title = "bemenu",
     .monitor = -1,
+    .delimiter = '\n',
 };
 
 static void
-read_items_to_menu_from_stdin(struct bm_menu *menu)
+read_items_to_menu_from_stdin(struct bm_menu *menu, char delimiter)
 {
     assert(menu);
 
-    ssize_t n;
-    size_t llen = 0;
-    char *line = NULL;
+    size_t len = 0, allocated = 0;
+    char *buffer = NULL;
 
-    while ((n = getline(&line, &llen, stdin)) > 0) {
-        // Remove trailing newline (if any)
-        if (line[n - 1] == '\n')
-            line[n - 1] = '\0';
+    /* regular files are read at once into a buffer of their size. They are not mapped, the menu
+     * terminates every line in place which would copy nearly every page of a private mapping anyway,
+     * and a mapped file that is truncated while the menu runs, e.g. by log rotation, kills it with SIGBUS. */
+    struct stat st;
+    off_t offset;
+    if (!fstat(STDIN_FILENO, &st) && S_ISREG(st.st_mode) && (offset = lseek(STDIN_FILENO, 0, SEEK_CUR)) >= 0 &&
+        st.st_size > offset && (uintmax_t)(st.st_size - offset) <= SIZE_MAX - 65536) {
+        const size_t size = (size_t)(st.st_size - offset) + 65536;
+        if ((buffer = malloc(size)))
+            allocated = size;
+    }
+
+    for (;;) {
+        /* read in large blocks, doubling keeps the copying of realloc linear */
+        if (allocated - len < 65536) {
+            const size_t grown = (allocated ? allocated * 2 : 262144);
+
+            void *tmp;
+            if (!(tmp = realloc(buffer, grown))) {
+                fprintf(stderr, "out of memory, the rest of stdin is not read\n");
+                break;
+            }
+
+            buffer = tmp;
+            allocated = grown;
+        }
+
+        ssize_t n;
+        if ((n = read(STDIN_FILENO, buffer + len, allocated - len)) < 0) {
+            if (errno == EINTR)
+                continue;
 
-        struct bm_item *item;
-        if (!(item = bm_item_new(line)))
+            perror("read failed");
             break;
+        }
+
+        if (n == 0)
+            break;
+
+        len += n;
+    }
+
+    /* the menu keeps the buffer, give back what was not filled */
+    void *tmp;
+    if (len > 0 && (tmp = realloc(buffer, len)))
+        buffer = tmp;
+
+    bm_menu_set_items_from_buffer(menu, buffer, len, delimiter, BM_BUFFER_FREE);
+}
+
+struct stream {
+    struct bm_menu *menu;
+    pthread_t thread;
+    bool running;
+    int fd;
+    char delimiter;
+
+    /**
+     * Partial last line kept for the next read.
+     */
+    char *buffer;
+    size_t len, allocated;
+};
+
+static bool
+push_lines(struct bm_menu *menu, char *lines, size_t len, char delimiter)
+{
+    uint32_t count = 0;
+    for (char *s = lines, *end = lines + len, *d; s < end; s = d + 1, ++count)
+        d = memchr(s, delimiter, end - s);
+
+    struct bm_item **items;
+    if (!(items = calloc(count, sizeof(struct bm_item*))))
+        return false;
+
+    uint32_t i = 0;
+    for (char *s = lines, *end = lines + len, *d; s < end; s = d + 1) {
+        d = memchr(s, delimiter, end - s);
+        *d = 0;
+
+        if (!(items[i] = bm_item_new(s)))
+            break;
+
+        i++;
+    }
+
+    const bool pushed = (i > 0 && bm_menu_push_items(menu, items, i));
+
+    if (!pushed) {
+        for (uint32_t k = 0; k < i; ++k)
+            bm_item_free(items[k]);
+    }
+
+    free(items);
+    return (pushed && i == count);
+}
+
+/**
+ * Read a block of input and queue its complete lines to the menu.
+ * Cancellation is only allowed while waiting for input.
+ *
+ * @return false at end of input or on failure.
+ */
+static bool
+stream_read(struct stream *stream)
+{
+    /* a line longer than the buffer */
+    if (stream->len == stream->allocated) {
+        const size_t grown = (stream->allocated ? stream->allocated * 2 : 65536);
+
+        void *tmp;
+        if (!(tmp = realloc(stream->buffer, grown)))
+            return false;
+
+        stream->buffer = tmp;
+        stream->allocated = grown;
+    }
+
+    /* only the reading thread is ever cancelled */
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    ssize_t n = read(stream->fd, stream->buffer + stream->len, stream->allocated - stream->len);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    if (n < 0 && errno == EINTR)
+        return true;
+
+    if (n <= 0) {
+        /* last line without a newline, there is room as the buffer is grown before reading */
+        if (stream->len > 0) {
+            stream->buffer[stream->len++] = stream->delimiter;
+            push_lines(stream->menu, stream->buffer, stream->len, stream->delimiter);
+            stream->len = 0;
+        }
+        return false;
+    }
+
+    stream->len += n;
 
-        bm_menu_add_item(menu, item);
+    /* queue complete lines, keep the partial last line for the next read */
+    size_t complete = stream->len;
+    for (; complete > 0 && stream->buffer[complete - 1] != stream->delimiter; --complete);
+
+    if (complete == 0)
+        return true;
+
+    if (!push_lines(stream->menu, stream->buffer, complete, stream->delimiter))
+        return false;
+
+    memmove(stream->buffer, stream->buffer + complete, stream->len - complete);
+    stream->len -= complete;
+    return true;
+}
+
+/**
+ * Read items until end of input.
+ */
+static void*
+stream_items(void *arg)
+{
+    struct stream *stream = arg;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while (stream_read(stream));
+    return NULL;
+}
+
+/**
+ * Prepare reading items in blocks, so the menu can be shown before input ends.
+ * Renderers may replace stdin with the terminal, so a duplicate of it is read.
+ */
+static bool
+stream_open(struct stream *stream, struct bm_menu *menu, char delimiter)
+{
+    *stream = (struct stream){ .menu = menu, .delimiter = delimiter };
+    return ((stream->fd = dup(STDIN_FILENO)) >= 0);
+}
+
+/**
+ * Read items until at least needed items match filter, or until input ends.
+ *
+ * @return true if input ended.
+ */
+static bool
+stream_until_matched(struct stream *stream, const char *filter, uint32_t needed)
+{
+    bm_menu_set_filter(stream->menu, filter);
+
+    bool more = true;
+    for (uint32_t count = 0; more && count < needed;) {
+        more = stream_read(stream);
+
+        do {
+            bm_menu_filter(stream->menu);
+        } while (bm_menu_is_filter_pending(stream->menu));
+
+        bm_menu_get_filtered_items(stream->menu, &count);
     }
-    free(line);
 
-    if (ferror(stdin)) {
-        fprintf(stderr, "getline failed");
-        return;
+    return !more;
+}
+
+/**
+ * Read the rest of the items in the background.
+ */
+static void
+stream_start(struct stream *stream)
+{
+    /* without a thread the menu waits for the rest instead */
+    if (!(stream->running = !pthread_create(&stream->thread, NULL, stream_items, stream)))
+        while (stream_read(stream));
+}
+
+static void
+stream_stop(struct stream *stream)
+{
+    if (stream->running) {
+        pthread_cancel(stream->thread);
+        pthread_join(stream->thread, NULL);
     }
+
+    close(stream->fd);
+    free(stream->buffer);
 }
 
 static void
 item_cb(const struct client *client, struct bm_item *item)
 {
-    (void)client;
-    const char *text = bm_item_get_text(item);
-    printf("%s\n", (text ? text : ""));
+    if (client->output_field > 0) {
+        const char *field = bm_item_get_field(item, client->output_field - 1);
+        fputs((field ? field : ""), stdout);
+    } else {
+        /* items split into fields are printed as they were read */
+        const char *field;
+        for (uint32_t i = 0; (field = bm_item_get_field(item, i)); ++i) {
+            if (i > 0)
+                putchar(client->field_separator);
+
+            fputs(field, stdout);
+        }
+    }
+
+    putchar(client->delimiter);
 }
 
 int
@@ -58,8 +278,39 @@ main(int argc, char **argv)
     if (!(menu = menu_with_options(&client)))
         return EXIT_FAILURE;
 
-    read_items_to_menu_from_stdin(menu);
+    if (client.field_separator && !bm_menu_set_fields(menu, client.field_separator, client.match_fields, client.nmatch_fields, client.display_fields, client.ndisplay_fields)) {
+        fprintf(stderr, "out of memory while setting up the fields of --field-separator\n");
+        bm_menu_free(menu);
+        return EXIT_FAILURE;
+    }
+
+    bm_menu_set_unique(menu, client.unique);
+
+    if (client.from_index && !bm_menu_set_items_from_index(menu, client.from_index)) {
+        fprintf(stderr, "failed to load index: %s\n", client.from_index);
+        bm_menu_free(menu);
+        return EXIT_FAILURE;
+    }
+
+    /* streamed items are not split into fields */
+    struct stream stream;
+    const bool streaming = (!client.from_index && client.stream && !client.field_separator && stream_open(&stream, menu, client.delimiter));
+
+    if (streaming) {
+        /* these only decide without the menu when few items match, so it is known after the first matches */
+        const uint32_t needed = (client.accept_single || client.auto_select ? 2 : 1);
+        if (!(client.ifne || client.accept_single || client.auto_select) || !stream_until_matched(&stream, client.initial_filter, needed))
+            stream_start(&stream);
+    } else if (!client.from_index) {
+        read_items_to_menu_from_stdin(menu, client.delimiter);
+    }
+
     const enum bm_run_result status = run_menu(&client, menu, item_cb);
+
+    if (streaming)
+        stream_stop(&stream);
+
+    print_stats(&client, menu);
     bm_menu_free(menu);
     switch (status) {
         case BM_RUN_RESULT_SELECTED:
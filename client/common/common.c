@@ -3,6 +3,7 @@
 #include "common.h"
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -192,6 +193,17 @@ usage(FILE *out, const char *name)
           " --accept-single       immediately return if there is only one item.\n"
           " --ifne                only display menu if there are items.\n"
           " --single-instance     force a single menu instance.\n"
+          " --latency-budget      limit time spent filtering per keystroke, e.g. 16ms.\n"
+          " --filter-engine       match items with the named filter engine plugin.\n"
+          " --stats               print memory usage to stderr on exit.\n"
+          " --stream              show the menu at once and add items as they are read (bemenu).\n"
+          " -0, --delimiter       separate items with the given byte instead of newline, NUL for -0. (bemenu)\n"
+          " --field-separator     split items into fields on the given byte. (bemenu)\n"
+          " --match-fields        filter on the given fields only, e.g. 2,4-5. (bemenu)\n"
+          " --display-fields      display the given fields only, e.g. 2,4-5. (bemenu)\n"
+          " --output-field        print the given field of selected items. (bemenu)\n"
+          " --from-index          read items from an index written by bemenu-index. (bemenu)\n"
+          " --unique              drop duplicate items, keeping the first one. (bemenu)\n"
           " --fork                always fork. (bemenu-run)\n"
           " --no-exec             do not execute command. (bemenu-run)\n"
           " --auto-select         when one entry is left, automatically select it\n\n"
@@ -262,6 +274,71 @@ set_monitor(struct client *client, char *arg)
     }
 }
 
+static char
+parse_delimiter(const char *arg)
+{
+    if (!strcmp(arg, "\\0") || !*arg)
+        return 0;
+
+    if (!strcmp(arg, "\\n"))
+        return '\n';
+
+    if (!strcmp(arg, "\\t"))
+        return '\t';
+
+    return arg[0];
+}
+
+/**
+ * Parse comma separated list of field numbers and ranges, e.g. "2,4-5".
+ * Fields are numbered from 1 on the command line and stored from 0.
+ *
+ * @return true on success, false if the list is malformed or out of memory, in which case no fields are stored.
+ */
+static bool
+parse_fields(const char *arg, uint32_t **out_fields, uint32_t *out_count)
+{
+    free(*out_fields);
+    *out_fields = NULL;
+    *out_count = 0;
+
+    uint32_t allocated = 0;
+    char *end;
+    for (const char *s = arg;; s = end + 1) {
+        /* strtoul would skip spaces and take signs */
+        unsigned long first, last;
+        if (!isdigit((unsigned char)*s) || !(first = last = strtoul(s, &end, 10)))
+            goto fail;
+
+        if (*end == '-' && (!isdigit((unsigned char)end[1]) || (last = strtoul(end + 1, &end, 10)) < first))
+            goto fail;
+
+        if (last > UINT32_MAX || (*end && *end != ','))
+            goto fail;
+
+        for (unsigned long f = first; f <= last; ++f) {
+            if (*out_count >= allocated) {
+                void *tmp;
+                if (!(tmp = realloc(*out_fields, sizeof(uint32_t) * (allocated = (allocated ? allocated * 2 : 8)))))
+                    goto fail;
+
+                *out_fields = tmp;
+            }
+
+            (*out_fields)[(*out_count)++] = f - 1;
+        }
+
+        if (!*end)
+            return true;
+    }
+
+fail:
+    free(*out_fields);
+    *out_fields = NULL;
+    *out_count = 0;
+    return false;
+}
+
 static void
 do_getopt(struct client *client, int *argc, char **argv[])
 {
@@ -328,6 +405,17 @@ do_getopt(struct client *client, int *argc, char **argv[])
         { "scf",          required_argument, 0, 0x115 },
         { "bdr",          required_argument, 0, 0x121 },
         { "binding",      required_argument, 0, 0x128 },
+        { "latency-budget", required_argument, 0, 0x129 },
+        { "filter-engine", required_argument, 0, 0x12a },
+        { "stats",        no_argument,       0, 0x12b },
+        { "stream",       no_argument,       0, 0x12c },
+        { "delimiter",    required_argument, 0, 0x12d },
+        { "field-separator", required_argument, 0, 0x12e },
+        { "match-fields", required_argument, 0, 0x12f },
+        { "display-fields", required_argument, 0, 0x130 },
+        { "output-field", required_argument, 0, 0x131 },
+        { "from-index",   required_argument, 0, 0x132 },
+        { "unique",       no_argument,       0, 0x133 },
 
         { "disco",       no_argument,       0, 0x116 },
         { 0, 0, 0, 0 }
@@ -340,7 +428,7 @@ do_getopt(struct client *client, int *argc, char **argv[])
     for (optind = 0;;) {
         int32_t opt;
 
-        if ((opt = getopt_long(*argc, *argv, "hviwcl:I:p:P:I:x:bfF:m:H:M:W:B:R:nsCTK", opts, NULL)) < 0)
+        if ((opt = getopt_long(*argc, *argv, "hviwcl:I:p:P:I:x:bfF:m:H:M:W:B:R:nsCTK0", opts, NULL)) < 0)
             break;
         
         switch (opt) {
@@ -529,6 +617,53 @@ do_getopt(struct client *client, int *argc, char **argv[])
                     client->key_binding = BM_KEY_BINDING_DEFAULT;
                 }
                 break;
+            case 0x129:
+                /* accepts both "16" and "16ms" */
+                client->latency_budget = strtoul(optarg, NULL, 10);
+                break;
+            case 0x12a:
+                client->filter_engine = optarg;
+                break;
+            case 0x12b:
+                client->stats = true;
+                break;
+            case 0x12c:
+                client->stream = true;
+                break;
+            case '0':
+                client->delimiter = 0;
+                break;
+            case 0x12d:
+                client->delimiter = parse_delimiter(optarg);
+                break;
+            case 0x12e:
+                /* 0 stands for not splitting items into fields */
+                if (!(client->field_separator = parse_delimiter(optarg))) {
+                    fprintf(stderr, "--field-separator can not be the NUL byte\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 0x12f:
+                if (!parse_fields(optarg, &client->match_fields, &client->nmatch_fields)) {
+                    fprintf(stderr, "invalid --match-fields '%s', expected field numbers from 1 and ranges, e.g. 2,4-5\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 0x130:
+                if (!parse_fields(optarg, &client->display_fields, &client->ndisplay_fields)) {
+                    fprintf(stderr, "invalid --display-fields '%s', expected field numbers from 1 and ranges, e.g. 2,4-5\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 0x131:
+                client->output_field = strtoul(optarg, NULL, 10);
+                break;
+            case 0x132:
+                client->from_index = optarg;
+                break;
+            case 0x133:
+                client->unique = true;
+                break;
 
             case 0x116:
                 disco();
@@ -568,6 +703,12 @@ menu_with_options(struct client *client)
         menu->vim_mode = 'n';
     }
 
+    if (client->filter_engine && !bm_menu_set_filter_engine(menu, client->filter_engine)) {
+        fprintf(stderr, "filter engine '%s' is not available\n", client->filter_engine);
+        bm_menu_free(menu);
+        return NULL;
+    }
+
     client->fork = (client->force_fork || (bm_renderer_get_priorty(bm_menu_get_renderer(menu)) != BM_PRIO_TERMINAL));
 
     bm_menu_set_font(menu, client->font);
@@ -594,6 +735,7 @@ menu_with_options(struct client *client)
     bm_menu_set_border_size(menu, client->border_size);
     bm_menu_set_border_radius(menu, client->border_radius);
     bm_menu_set_key_binding(menu, client->key_binding);
+    bm_menu_set_latency_budget(menu, client->latency_budget);
 
     if (client->center) {
         bm_menu_set_align(menu, BM_ALIGN_CENTER);
@@ -613,9 +755,45 @@ menu_with_options(struct client *client)
         bm_menu_set_filter(menu, NULL);
     }
 
+    /* connect to the display while items are read, unless the items may decide the menu is not shown */
+    if (!client->ifne && !client->accept_single && !client->auto_select)
+        bm_menu_start_renderer(menu);
+
     return menu;
 }
 
+void
+print_stats(const struct client *client, const struct bm_menu *menu)
+{
+    if (!client->stats)
+        return;
+
+    struct bm_memory_stats stats;
+    bm_menu_get_memory_stats(menu, &stats);
+
+    const struct {
+        const char *name;
+        size_t size;
+    } rows[] = {
+        { "items", stats.items },
+        { "text", stats.text },
+        { "arena", stats.arena },
+        { "buffers", stats.buffers },
+        { "coded", stats.coded },
+        { "lists", stats.lists },
+        { "caches", stats.caches },
+        { "renderer", stats.renderer },
+        { "total", stats.total },
+    };
+
+    uint32_t count;
+    bm_menu_get_items(menu, &count);
+    fprintf(stderr, "memory usage of %u items:\n", count);
+
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i)
+        fprintf(stderr, "  %-9s %12zu bytes\n", rows[i].name, rows[i].size);
+}
+
 enum bm_run_result
 run_menu(const struct client *client, struct bm_menu *menu, void (*item_cb)(const struct client *client, struct bm_item *item))
 {
@@ -638,6 +816,10 @@ run_menu(const struct client *client, struct bm_menu *menu, void (*item_cb)(cons
     bm_menu_set_filter(menu, client->initial_filter);
     bm_menu_filter(menu);
 
+    /* decisions below must not be made on partial results */
+    while ((client->ifne || client->accept_single || client->auto_select) && bm_menu_is_filter_pending(menu))
+        bm_menu_filter(menu);
+
     {
     uint32_t item_count;
     struct bm_item **items = bm_menu_get_filtered_items(menu, &item_count);
@@ -659,7 +841,7 @@ run_menu(const struct client *client, struct bm_menu *menu, void (*item_cb)(cons
     struct bm_touch touch = {0};
     enum bm_run_result status = BM_RUN_RESULT_RUNNING;
     do {
-        if(client->auto_select) {
+        if(client->auto_select && !bm_menu_is_filter_pending(menu)) {
             uint32_t item_count;
             bm_menu_get_filtered_items(menu, &item_count);
             if(item_count == 1) {
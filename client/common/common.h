@@ -45,6 +45,17 @@ struct client {
     bool no_exec;
     enum bm_password_mode password;
     enum bm_key_binding key_binding;
+    uint32_t latency_budget;
+    const char *filter_engine;
+    bool stats;
+    bool stream;
+    char delimiter;
+    char field_separator;
+    uint32_t *match_fields, nmatch_fields;
+    uint32_t *display_fields, ndisplay_fields;
+    uint32_t output_field;
+    const char *from_index;
+    bool unique;
     char *monitor_name;
 };
 
@@ -52,6 +63,7 @@ char* cstrcopy(const char *str, size_t size);
 char** tokenize_quoted_to_argv(const char *str, char *argv0, int *out_argc);
 void parse_args(struct client *client, int *argc, char **argv[]);
 struct bm_menu* menu_with_options(struct client *client);
+void print_stats(const struct client *client, const struct bm_menu *menu);
 enum bm_run_result run_menu(const struct client *client, struct bm_menu *menu, void (*item_cb)(const struct client *client, struct bm_item *item));
 
 #endif /* _BM_COMMON_H_ */
@@ -0,0 +1,70 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * Default size of an arena block.
+ * Allocations larger than this get a block of their own.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/**
+ * Chunk of memory allocations are bumped from.
+ */
+struct arena_block {
+    /**
+     * Previously filled block.
+     */
+    struct arena_block *prev;
+
+    /**
+     * Bytes used and available in data.
+     */
+    size_t used, size;
+
+    /**
+     * Memory handed out by the arena.
+     */
+    char data[];
+};
+
+void*
+arena_alloc(struct arena *arena, size_t size, size_t align)
+{
+    assert(arena && align > 0 && !(align & (align - 1)));
+
+    struct arena_block *block = arena->block;
+    size_t offset = (block ? (block->used + align - 1) & ~(align - 1) : 0);
+
+    if (!block || offset + size > block->size) {
+        size_t bsize = (size + align > ARENA_BLOCK_SIZE ? size + align : ARENA_BLOCK_SIZE);
+        if (!(block = malloc(sizeof(struct arena_block) + bsize)))
+            return NULL;
+
+        block->prev = arena->block;
+        block->used = 0;
+        block->size = bsize;
+        arena->block = block;
+        arena->size += bsize;
+        offset = (((uintptr_t)block->data + align - 1) & ~(uintptr_t)(align - 1)) - (uintptr_t)block->data;
+    }
+
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+void
+arena_release(struct arena *arena)
+{
+    assert(arena);
+
+    for (struct arena_block *block = arena->block, *prev; block; block = prev) {
+        prev = block->prev;
+        free(block);
+    }
+
+    arena->block = NULL;
+    arena->size = 0;
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -24,11 +24,13 @@
  */
 
 struct bm_renderer;
+struct bm_filter_engine;
 struct bm_menu;
 struct bm_item;
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * @defgroup Library
@@ -60,10 +62,10 @@ struct bm_item;
  * @{ */
 
 /**
- * Init bemenu, loads up the renderers.
+ * Init bemenu, loads up the renderers and filter engines.
  *
  * You can force single renderer with BEMENU_RENDERER env variable,
- * and directory containing renderers with BEMENU_RENDERERS env variable.
+ * and directory containing renderers and filter engines with BEMENU_RENDERERS env variable.
  *
  * @return true on success, false on failure.
  */
@@ -77,6 +79,14 @@ BM_PUBLIC bool bm_init(void);
  */
 BM_PUBLIC const struct bm_renderer** bm_get_renderers(uint32_t *out_nmemb);
 
+/**
+ * Get list of available filter engines.
+ *
+ * @param out_nmemb Reference to uint32_t where total count of returned filter engines will be stored.
+ * @return Pointer to array of bm_filter_engine instances.
+ */
+BM_PUBLIC const struct bm_filter_engine** bm_get_filter_engines(uint32_t *out_nmemb);
+
 /** @} Library Initialization */
 
 /**
@@ -154,6 +164,21 @@ BM_PUBLIC enum bm_priorty bm_renderer_get_priorty(const struct bm_renderer *rend
 /**
  * @} Renderer */
 
+/**
+ * @addtogroup FilterEngine
+ * @{ */
+
+/**
+ * Get name of the filter engine.
+ *
+ * @param engine bm_filter_engine instance.
+ * @return Null terminated C "string" to filter engine's name.
+ */
+BM_PUBLIC const char* bm_filter_engine_get_name(const struct bm_filter_engine *engine);
+
+/**
+ * @} FilterEngine */
+
 /**
  * @addtogroup Menu
  * @{ */
@@ -200,6 +225,19 @@ enum bm_password_mode {
     BM_PASSWORD_INDICATOR,
 };
 
+/**
+ * Ownership constants for buffers items are loaded from.
+ *
+ * - @link ::bm_buffer_ownership BM_BUFFER_BORROW @endlink means that the caller keeps the buffer alive until the items are freed.
+ * - @link ::bm_buffer_ownership BM_BUFFER_FREE @endlink means that the buffer is released with free() together with the items.
+ * - @link ::bm_buffer_ownership BM_BUFFER_MUNMAP @endlink means that the buffer is released with munmap() together with the items.
+ */
+enum bm_buffer_ownership {
+    BM_BUFFER_BORROW,
+    BM_BUFFER_FREE,
+    BM_BUFFER_MUNMAP,
+};
+
 /**
  * Vertical menu display mode constants for bm_menu instance lines.
  *
@@ -274,6 +312,9 @@ enum bm_key {
     BM_KEY_CUSTOM_8,
     BM_KEY_CUSTOM_9,
     BM_KEY_CUSTOM_10,
+    BM_KEY_SELECT_ALL,
+    BM_KEY_INVERT_SELECTION,
+    BM_KEY_CLEAR_SELECTION,
     BM_KEY_UNICODE,
     BM_KEY_LAST
 };
@@ -398,6 +439,9 @@ enum bm_key_binding {
  * If **NULL** is used as renderer, auto-detection will be used or the renderer with the name pointed by BEMENU_BACKEND env variable.
  * It's good idea to use NULL, if you want user to have control over the renderer with this env variable.
  *
+ * The renderer is constructed by the first bm_menu_render, bm_menu_get_height or bm_menu_get_width call,
+ * so a menu that is never shown does not connect to the display. Options set before are passed to it then.
+ *
  * @param renderer Name of renderer to be used for this instance, pass **NULL** for auto-detection.
  * @return bm_menu for new menu instance, **NULL** if creation failed.
  */
@@ -412,6 +456,7 @@ BM_PUBLIC void bm_menu_free(struct bm_menu *menu);
 
 /**
  * Release items inside bm_menu instance.
+ * Also releases every item created with bm_menu_new_item, even ones no longer in the menu.
  *
  * @param menu bm_menu instance which items will be freed from memory.
  */
@@ -426,6 +471,8 @@ BM_PUBLIC void bm_menu_free_items(struct bm_menu *menu);
 /**
  * Get the renderer from the bm_menu instance.
  *
+ * Before the menu is first rendered this is the renderer that will be tried first.
+ *
  * @param menu bm_menu instance which renderer to get.
  * @return Pointer to bm_renderer instance.
  */
@@ -499,6 +546,26 @@ BM_PUBLIC void bm_menu_set_filter_mode(struct bm_menu *menu, enum bm_filter_mode
  */
 BM_PUBLIC enum bm_filter_mode bm_menu_get_filter_mode(const struct bm_menu *menu);
 
+/**
+ * Set filter engine used to match items instead of the built-in filters.
+ * The filter mode is passed to the engine, which may interpret it as it sees fit.
+ *
+ * Filtering with an engine always runs to completion and is not speculated ahead of time.
+ *
+ * @param menu bm_menu instance where to set filter engine.
+ * @param name Name of the filter engine, **NULL** for the built-in filters.
+ * @return true if filter engine was found and loaded.
+ */
+BM_PUBLIC bool bm_menu_set_filter_engine(struct bm_menu *menu, const char *name);
+
+/**
+ * Get filter engine from bm_menu instance.
+ *
+ * @param menu bm_menu instance where to get filter engine from.
+ * @return Pointer to bm_filter_engine instance, **NULL** if built-in filters are used.
+ */
+BM_PUBLIC const struct bm_filter_engine* bm_menu_get_filter_engine(const struct bm_menu *menu);
+
 /**
  * Set amount of max vertical lines to be shown.
  * Some renderers such as ncurses may ignore this when it does not make sense.
@@ -926,6 +993,26 @@ BM_PUBLIC void bm_menu_set_spacing(struct bm_menu *menu, bool spacing);
 BM_PUBLIC enum bm_password_mode bm_menu_get_password(struct bm_menu *menu);
 
 
+/**
+ * Set latency budget for filtering and rendering after a keystroke.
+ *
+ * When filtering does not fit in half of the budget, the matches found so far are shown
+ * and filtering continues on the following bm_menu_filter calls.
+ * Ranking of exact and prefix matches is postponed until all items have been matched.
+ *
+ * @param menu bm_menu instance where to set latency budget.
+ * @param budget Budget in milliseconds, 0 to always filter to completion.
+ */
+BM_PUBLIC void bm_menu_set_latency_budget(struct bm_menu *menu, uint32_t budget);
+
+/**
+ * Get latency budget for filtering and rendering after a keystroke.
+ *
+ * @param menu bm_menu instance where to get latency budget from.
+ * @return Budget in milliseconds, 0 if filtering always runs to completion.
+ */
+BM_PUBLIC uint32_t bm_menu_get_latency_budget(const struct bm_menu *menu);
+
 /**
  * Specify the key bindings that should be used. 
  *
@@ -941,6 +1028,47 @@ BM_PUBLIC void bm_menu_set_key_binding(struct bm_menu *menu, enum bm_key_binding
  * @name Menu Items
  * @{ */
 
+/**
+ * Allocate a new item from memory owned by bm_menu instance.
+ * Cheaper than bm_item_new when loading a large amount of items.
+ *
+ * The item is not added to the menu. It may be passed to bm_item_free,
+ * but its memory is only released by bm_menu_free_items or bm_menu_free.
+ *
+ * @param menu bm_menu instance which owns the item memory.
+ * @param text Pointer to null terminated C "string", can be **NULL** for empty text.
+ * @return bm_item for new item instance, **NULL** if creation failed.
+ */
+BM_PUBLIC struct bm_item* bm_menu_new_item(struct bm_menu *menu, const char *text);
+
+/**
+ * Add items with front coded text to bm_menu instance.
+ *
+ * Texts are copied into a compact store where each text only keeps what differs from the previous one,
+ * so sorted texts sharing long prefixes, like paths, take a fraction of their size.
+ * Filtering decodes the texts as it scans them, bm_item_get_text decodes the text of an item once
+ * and keeps it until the items are freed.
+ *
+ * Memory of the items is owned by the menu like with bm_menu_new_item,
+ * and released by bm_menu_free_items or bm_menu_free.
+ *
+ * @param menu bm_menu instance where items will be added.
+ * @param texts Array of null terminated C "strings", preferably sorted. **NULL** is added as empty text.
+ * @param nmemb Count of texts in array.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_menu_add_items_front_coded(struct bm_menu *menu, const char **texts, uint32_t nmemb);
+
+/**
+ * Reserve room for items in bm_menu instance.
+ * Adding items up to the reserved count does not reallocate the item list.
+ *
+ * @param menu bm_menu instance where room will be reserved.
+ * @param nmemb Total count of items to reserve room for.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_menu_reserve_items(struct bm_menu *menu, uint32_t nmemb);
+
 /**
  * Add item to bm_menu instance at specific index.
  *
@@ -960,6 +1088,32 @@ BM_PUBLIC bool bm_menu_add_item_at(struct bm_menu *menu, struct bm_item *item, u
  */
 BM_PUBLIC bool bm_menu_add_item(struct bm_menu *menu, struct bm_item *item);
 
+/**
+ * Queue items to be added to bm_menu instance from any thread.
+ * Queued items are added by the next bm_menu_run_with_key or bm_menu_filter call, and only they are matched against the current filter.
+ *
+ * @warning Items must be created with bm_item_new, they are owned by the menu once queued.
+ *
+ * @param menu bm_menu instance where items will be added.
+ * @param items Array of bm_item pointers to add.
+ * @param nmemb Total count of items in array.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_menu_push_items(struct bm_menu *menu, struct bm_item **items, uint32_t nmemb);
+
+/**
+ * Queue items to be removed from bm_menu instance from any thread.
+ * Queued items are removed and freed by the next bm_menu_run_with_key call.
+ *
+ * @warning Items must not be used after they are queued.
+ *
+ * @param menu bm_menu instance from where items will be removed.
+ * @param items Array of bm_item pointers to remove.
+ * @param nmemb Total count of items in array.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_menu_retract_items(struct bm_menu *menu, struct bm_item **items, uint32_t nmemb);
+
 /**
  * Remove item from bm_menu instance at specific index.
  *
@@ -982,6 +1136,21 @@ BM_PUBLIC bool bm_menu_remove_item_at(struct bm_menu *menu, uint32_t index);
  */
 BM_PUBLIC bool bm_menu_remove_item(struct bm_menu *menu, struct bm_item *item);
 
+/**
+ * Remove every item matching predicate from bm_menu instance.
+ * The items, filtered items and selection are compacted in a single pass each,
+ * keeping the order of the remaining items.
+ *
+ * @warning The items won't be freed, use bm_item_free to do that once this returns successfully.
+ *          Predicate must not free items, on failure they are all still in the menu.
+ *
+ * @param menu bm_menu instance from where items will be removed.
+ * @param predicate Function called once per item in index order, returning true for items to remove.
+ * @param userdata Pointer passed to predicate.
+ * @return Number of removed items, or -1 on failure, in which case no item was removed.
+ */
+BM_PUBLIC int64_t bm_menu_remove_items(struct bm_menu *menu, bool (*predicate)(struct bm_item *item, uint32_t index, void *userdata), void *userdata);
+
 /**
  * Highlight item in menu by index.
  *
@@ -1031,6 +1200,31 @@ BM_PUBLIC bool bm_menu_set_selected_items(struct bm_menu *menu, struct bm_item *
  */
 BM_PUBLIC struct bm_item** bm_menu_get_selected_items(const struct bm_menu *menu, uint32_t *out_nmemb);
 
+/**
+ * Add every currently filtered item to the selection.
+ * Items already selected keep their place in the selection order.
+ *
+ * @param menu bm_menu instance where items will be selected.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_menu_select_filtered_items(struct bm_menu *menu);
+
+/**
+ * Invert the selection within the currently filtered items.
+ * Selected items that are filtered out stay selected.
+ *
+ * @param menu bm_menu instance where selection will be inverted.
+ * @return true on success, false on failure, in which case the selection is unchanged.
+ */
+BM_PUBLIC bool bm_menu_invert_selection(struct bm_menu *menu);
+
+/**
+ * Clear the selection.
+ *
+ * @param menu bm_menu instance where selection will be cleared.
+ */
+BM_PUBLIC void bm_menu_clear_selection(struct bm_menu *menu);
+
 /**
  * Set items to bm_menu instance.
  * Will replace all the old items on bm_menu instance.
@@ -1044,6 +1238,97 @@ BM_PUBLIC struct bm_item** bm_menu_get_selected_items(const struct bm_menu *menu
  */
 BM_PUBLIC bool bm_menu_set_items(struct bm_menu *menu, const struct bm_item **items, uint32_t nmemb);
 
+/**
+ * Set items to bm_menu instance from delimiter separated text in a buffer.
+ * Will replace all the old items on bm_menu instance, like bm_menu_free_items.
+ *
+ * Item texts point into the buffer instead of being copied, so the buffer must be writable,
+ * delimiters are replaced with null terminators. A trailing delimiter does not produce an empty item.
+ *
+ * With BM_BUFFER_FREE and BM_BUFFER_MUNMAP the menu takes ownership of the buffer,
+ * also when loading fails.
+ *
+ * @param menu bm_menu instance where items will be set.
+ * @param buffer Buffer containing the item texts.
+ * @param len Length of the buffer in bytes.
+ * @param delimiter Byte that separates items, usually '\n'.
+ * @param ownership bm_buffer_ownership constant.
+ * @return true on successful set, false on failure.
+ */
+BM_PUBLIC bool bm_menu_set_items_from_buffer(struct bm_menu *menu, char *buffer, size_t len, char delimiter, enum bm_buffer_ownership ownership);
+
+/**
+ * Set items to bm_menu instance from an item index written by bm_write_index.
+ * Will replace all the old items on bm_menu instance, like bm_menu_free_items.
+ *
+ * The index is mapped read-only and item texts point into the mapping, which is released with the items.
+ * Nothing is parsed, also the data filtering needs per item is read from the index.
+ *
+ * @param menu bm_menu instance where items will be set.
+ * @param path Path of the index file.
+ * @return true on successful set, false if the index can not be read or is not valid.
+ */
+BM_PUBLIC bool bm_menu_set_items_from_index(struct bm_menu *menu, const char *path);
+
+/**
+ * Write item index for bm_menu_set_items_from_index.
+ * The index is written to a temporary file which then replaces path.
+ *
+ * @param path Path of the index file.
+ * @param texts Array of item texts, **NULL** is stored as empty text.
+ * @param count Count of texts in array.
+ * @return true on success, false on failure.
+ */
+BM_PUBLIC bool bm_write_index(const char *path, const char **texts, uint32_t count);
+
+/**
+ * Drop items whose text equals an earlier item.
+ * Applies to items loaded afterwards with bm_menu_set_items_from_buffer or bm_menu_set_items_from_index,
+ * and to items queued with bm_menu_push_items. The first occurrence is kept, in its place.
+ * Items split into fields must have every field equal.
+ *
+ * @param menu bm_menu instance where to set duplicate dropping.
+ * @param unique true to drop duplicates.
+ */
+BM_PUBLIC void bm_menu_set_unique(struct bm_menu *menu, bool unique);
+
+/**
+ * Get whether duplicate items are dropped.
+ *
+ * @param menu bm_menu instance where to get duplicate dropping from.
+ * @return true if duplicates are dropped.
+ */
+BM_PUBLIC bool bm_menu_get_unique(const struct bm_menu *menu);
+
+/**
+ * Split items into fields.
+ * Applies to items loaded afterwards with bm_menu_set_items_from_buffer, which are split in place
+ * without copying, see bm_item_get_field.
+ *
+ * Filtering matches every filter token against one of the match fields,
+ * and exact and prefix matches are ranked by the first match field.
+ * Renderers show the display fields joined with the separator, see bm_menu_get_item_display_text.
+ *
+ * @param menu bm_menu instance where to set field layout.
+ * @param separator Byte that separates fields, 0 to not split items.
+ * @param match Indices of the fields to match, starting from 0. Every field is matched if **NULL**.
+ * @param nmatch Count of indices in match.
+ * @param display Indices of the fields to display, starting from 0. Every field is displayed if **NULL**.
+ * @param ndisplay Count of indices in display.
+ * @return true on success, false if out of memory.
+ */
+BM_PUBLIC bool bm_menu_set_fields(struct bm_menu *menu, char separator, const uint32_t *match, uint32_t nmatch, const uint32_t *display, uint32_t ndisplay);
+
+/**
+ * Get text to display for item.
+ * The display fields of items split into fields, the text of other items.
+ *
+ * @param menu bm_menu instance the item belongs to.
+ * @param item bm_item instance to get display text of.
+ * @return Pointer to null terminated C "string", valid until the next call. **NULL** for empty text or if out of memory.
+ */
+BM_PUBLIC const char* bm_menu_get_item_display_text(struct bm_menu *menu, const struct bm_item *item);
+
 /**
  * Get items from bm_menu instance.
  *
@@ -1073,12 +1358,25 @@ BM_PUBLIC struct bm_item** bm_menu_get_filtered_items(const struct bm_menu *menu
  * @name Menu Logic
  * @{ */
 
+/**
+ * Start constructing the renderer on another thread, so connecting to the display overlaps with loading items.
+ * Functions that use the renderer wait for it to finish.
+ *
+ * @warning Set the options of the menu before, the renderer reads them while it is constructed.
+ *
+ * @param menu bm_menu instance whose renderer to construct.
+ * @return true if construction was started or the renderer is already constructed, false otherwise.
+ */
+BM_PUBLIC bool bm_menu_start_renderer(struct bm_menu *menu);
+
 /**
  * Render bm_menu instance using chosen renderer.
  *
  * This function may block on **wayland** and **x11** renderer.
+ * The first call constructs the renderer.
  *
  * @param menu bm_menu instance to be rendered.
+ * @return true on success, false if rendering failed or no renderer could be constructed.
  */
 BM_PUBLIC bool bm_menu_render(struct bm_menu *menu);
 
@@ -1089,10 +1387,91 @@ BM_PUBLIC bool bm_menu_render(struct bm_menu *menu);
  * Do note that filtering might be heavy, so you should only call it after batch manipulation of items.
  * Not after manipulation of each single item.
  *
+ * On menus of at least 10000 items the results for the most likely next filters are computed on a
+ * background thread, and used instead of filtering again when the filter changes to one of them.
+ *
+ * @warning The background thread reads the texts of the items after this returns, until the next call that
+ *          changes the items or filters them. Texts of such a menu's items must not be changed with
+ *          bm_item_set_text in between. Remove the item with bm_menu_remove_item_at first, which stops
+ *          the thread, and add it back with bm_menu_add_item_at.
+ *
  * @param menu bm_menu instance which to filter.
  */
 BM_PUBLIC void bm_menu_filter(struct bm_menu *menu);
 
+/**
+ * Is filtering still in progress?
+ * Happens when filtering did not fit in the latency budget, see bm_menu_set_latency_budget,
+ * and when items changed in a way that leaves the filtered items behind.
+ * Filtered items are partial and unranked until bm_menu_filter completes them.
+ *
+ * @param menu bm_menu instance to check.
+ * @return true if filtered items are partial.
+ */
+BM_PUBLIC bool bm_menu_is_filter_pending(const struct bm_menu *menu);
+
+/**
+ * Memory used by bm_menu instance, in bytes.
+ *
+ * items and text are what the items take wherever they are stored,
+ * arena, buffers and coded are the storage of items from bm_menu_new_item, bm_menu_set_items_from_buffer
+ * and bm_menu_add_items_front_coded.
+ */
+struct bm_memory_stats {
+    /**
+     * bm_item structs.
+     */
+    size_t items;
+
+    /**
+     * Item text including terminators.
+     */
+    size_t text;
+
+    /**
+     * Arena blocks of items created with bm_menu_new_item and their text.
+     */
+    size_t arena;
+
+    /**
+     * Buffers items were loaded from.
+     */
+    size_t buffers;
+
+    /**
+     * Front coded stores of items added with bm_menu_add_items_front_coded, including decoded text.
+     */
+    size_t coded;
+
+    /**
+     * Capacity of the item, filtered and selection lists.
+     */
+    size_t lists;
+
+    /**
+     * Column store, selection set, position index, duplicate set and speculative results.
+     */
+    size_t caches;
+
+    /**
+     * Buffers of the renderer, if it reports them.
+     */
+    size_t renderer;
+
+    /**
+     * Every byte above counted once.
+     */
+    size_t total;
+};
+
+/**
+ * Get memory used by bm_menu instance.
+ *
+ * @param menu bm_menu instance to inspect.
+ * @param out_stats Reference to bm_memory_stats where the usage will be stored.
+ */
+BM_PUBLIC void bm_menu_get_memory_stats(const struct bm_menu *menu, struct bm_memory_stats *out_stats);
+
 /**
  * Poll key and unicode from underlying UI toolkit.
  *
@@ -1224,6 +1603,9 @@ BM_PUBLIC void* bm_item_get_userdata(struct bm_item *item);
 /**
  * Set text to bm_item instance.
  *
+ * @warning Items of a menu of at least 10000 items are read by a background thread between bm_menu_filter calls,
+ *          see bm_menu_filter before changing their text.
+ *
  * @param item bm_item instance where to set text.
  * @param text C "string" to set as text, can be **NULL** for empty text.
  * @return true if set was succesful, false if out of memory.
@@ -1238,6 +1620,17 @@ BM_PUBLIC bool bm_item_set_text(struct bm_item *item, const char *text);
  */
 BM_PUBLIC const char* bm_item_get_text(const struct bm_item *item);
 
+/**
+ * Get field of bm_item instance.
+ * Items loaded after bm_menu_set_fields are split into fields, their text is their first field.
+ * Other items have their text as the only field.
+ *
+ * @param item bm_item instance where to get field from.
+ * @param field Index of the field, starting from 0.
+ * @return Pointer to null terminated C "string", **NULL** if the item has no such field.
+ */
+BM_PUBLIC const char* bm_item_get_field(const struct bm_item *item, uint32_t field);
+
 /**  @} Item Properties */
 
 /**  @} Item */
@@ -0,0 +1,197 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+uint64_t
+columns_signature(const char *text, uint32_t *out_len)
+{
+    uint64_t signature = 0;
+    const unsigned char *s = (const unsigned char*)text;
+    for (; s && *s; ++s)
+        signature |= (uint64_t)1 << (toupper(*s) & 63);
+
+    if (out_len)
+        *out_len = (text ? (uint32_t)(s - (const unsigned char*)text) : 0);
+
+    return signature;
+}
+
+static bool
+grow(struct columns *columns, uint32_t count)
+{
+    uint32_t allocated = (columns->allocated ? columns->allocated : 1024);
+    while (allocated < count)
+        allocated *= 2;
+
+    const struct bm_item **item;
+    if (!(item = realloc(columns->item, sizeof(struct bm_item*) * allocated)))
+        return false;
+
+    columns->item = item;
+
+    uint16_t *revision;
+    if (!(revision = realloc(columns->revision, sizeof(uint16_t) * allocated)))
+        return false;
+
+    columns->revision = revision;
+
+    uint32_t *len;
+    if (!(len = realloc(columns->len, sizeof(uint32_t) * allocated)))
+        return false;
+
+    columns->len = len;
+
+    uint64_t *signature;
+    if (!(signature = realloc(columns->signature, sizeof(uint64_t) * allocated)))
+        return false;
+
+    columns->signature = signature;
+    columns->allocated = allocated;
+    return true;
+}
+
+/**
+ * Make room for count rows without changing the rows covered.
+ */
+bool
+columns_reserve(struct columns *columns, uint32_t count)
+{
+    assert(columns);
+    return (columns->allocated >= count || grow(columns, count));
+}
+
+/**
+ * Copy row from to row to, when rows are removed.
+ */
+void
+columns_move(struct columns *columns, uint32_t to, uint32_t from)
+{
+    assert(columns && to < columns->allocated && from < columns->allocated);
+    columns->item[to] = columns->item[from];
+    columns->revision[to] = columns->revision[from];
+    columns->len[to] = columns->len[from];
+    columns->signature[to] = columns->signature[from];
+}
+
+/**
+ * Signature of every field of an item split into fields, any of them may be matched.
+ * Length is the length of the longest field, as a token has to fit in one field.
+ */
+static uint64_t
+fields_signature(const struct bm_item *item, uint32_t *out_len)
+{
+    uint64_t signature = 0;
+    *out_len = 0;
+
+    const char *field;
+    for (uint32_t i = 0; (field = bm_item_get_field(item, i)); ++i) {
+        uint32_t len;
+        signature |= columns_signature(field, &len);
+        *out_len = (len > *out_len ? len : *out_len);
+    }
+
+    return signature;
+}
+
+static void
+compute_row(struct columns *columns, uint32_t row, struct bm_item *item, struct fccursor *cursor)
+{
+    columns->item[row] = item;
+    columns->revision[row] = item->revision;
+
+    if (item->flags & BM_ITEM_FIELDS) {
+        columns->signature[row] = fields_signature(item, &columns->len[row]);
+    } else {
+        columns->signature[row] = columns_signature(fccursor_text(cursor, item), &columns->len[row]);
+    }
+}
+
+bool
+columns_update(struct columns *columns, struct bm_item **items, uint32_t count)
+{
+    assert(columns);
+
+    if (columns->count > count)
+        columns->count = 0;
+
+    struct fccursor cursor = {0};
+
+    /* texts of covered items changed through bm_item_set_text since the rows were checked */
+    const uint32_t revision = item_text_revision();
+    if (columns->checked != revision) {
+        for (uint32_t i = 0; i < columns->count; ++i) {
+            if (columns->item[i] == items[i] && columns->revision[i] != items[i]->revision)
+                compute_row(columns, i, items[i], &cursor);
+        }
+
+        columns->checked = revision;
+    }
+
+    if (columns->count < count && (columns->allocated >= count || grow(columns, count))) {
+        for (uint32_t i = columns->count; i < count; ++i)
+            compute_row(columns, i, items[i], &cursor);
+
+        columns->count = count;
+    }
+
+    fccursor_release(&cursor);
+    return (columns->count == count);
+}
+
+/**
+ * Fill the column store from precomputed signatures and lengths, e.g. from an item index.
+ * The items must hold their own plain text.
+ */
+bool
+columns_seed(struct columns *columns, struct bm_item **items, const uint64_t *signatures, const uint32_t *lens, uint32_t count)
+{
+    assert(columns && (count == 0 || (items && signatures && lens)));
+
+    if (!columns_reserve(columns, count))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        columns->item[i] = items[i];
+        columns->revision[i] = items[i]->revision;
+    }
+
+    memcpy(columns->signature, signatures, sizeof(uint64_t) * count);
+    memcpy(columns->len, lens, sizeof(uint32_t) * count);
+    columns->count = count;
+    return true;
+}
+
+void
+columns_invalidate(struct columns *columns)
+{
+    assert(columns);
+    columns->count = 0;
+}
+
+void
+columns_release(struct columns *columns)
+{
+    assert(columns);
+    free(columns->item);
+    free(columns->revision);
+    free(columns->len);
+    free(columns->signature);
+    memset(columns, 0, sizeof(struct columns));
+}
+
+struct columns
+columns_slice(const struct columns *columns, uint32_t offset)
+{
+    assert(columns && offset <= columns->count);
+    return (struct columns){
+        .item = columns->item + offset,
+        .revision = columns->revision + offset,
+        .len = columns->len + offset,
+        .signature = columns->signature + offset,
+        .count = columns->count - offset,
+    };
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -38,20 +38,20 @@ shrink_list(struct bm_item ***in_out_list, size_t osize, size_t nsize)
 /**
  * Text filter tokenizer helper.
  *
- * @param menu bm_menu instance which filter to tokenize.
+ * @param filter Filter text to tokenize.
  * @param out_tokv char pointer reference to list of tokens, this should be freed after use.
  * @param out_tokc uint32_t reference to number of tokens.
  * @return Pointer to buffer that contains tokenized string, this should be freed after use.
  */
 static char*
-tokenize(struct bm_menu *menu, char ***out_tokv, uint32_t *out_tokc)
+tokenize(const char *filter, char ***out_tokv, uint32_t *out_tokc)
 {
-    assert(menu && out_tokv && out_tokc);
+    assert(filter && out_tokv && out_tokc);
     *out_tokv = NULL;
     *out_tokc = 0;
 
     char **tokv = NULL, *buffer = NULL;
-    if (!(buffer = bm_strdup(menu->filter)))
+    if (!(buffer = bm_strdup(filter)))
         goto fail;
 
     char *s;
@@ -79,30 +79,177 @@ fail:
     return NULL;
 }
 
+/**
+ * Substring and comparison functions used by a filter mode.
+ */
+struct matcher {
+    char* (*fstrstr)(const char *a, const char *b);
+    int (*fstrncmp)(const char *a, const char *b, size_t len);
+    const struct fields *fields;
+};
+
+static struct matcher
+matcher_for_mode(enum bm_filter_mode mode, const struct fields *fields)
+{
+    if (mode == BM_FILTER_MODE_DMENU_CASE_INSENSITIVE)
+        return (struct matcher){ bm_strupstr, bm_strnupcmp, fields };
+
+    return (struct matcher){ strstr, strncmp, fields };
+}
+
+/**
+ * Does a matched field of an item split into fields contain the token.
+ */
+static bool
+fields_contain(const struct fields *fields, const struct bm_item *item, const char *token, char* (*fstrstr)(const char *a, const char *b))
+{
+    const char *field;
+    if (fields && fields->nmatch) {
+        for (uint32_t i = 0; i < fields->nmatch; ++i) {
+            if ((field = bm_item_get_field(item, fields->match[i])) && fstrstr(field, token))
+                return true;
+        }
+
+        return false;
+    }
+
+    for (uint32_t i = 0; (field = bm_item_get_field(item, i)); ++i) {
+        if (fstrstr(field, token))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Collect items that contain every filter token, in their original order.
+ *
+ * With columns, items whose signature or length rules out a match are skipped without
+ * touching the item or its text. Texts of the rest are read from the items.
+ *
+ * @param tokv Filter tokens.
+ * @param tokc Number of filter tokens.
+ * @param items Array of bm_item pointers to match.
+ * @param count Number of items in the array.
+ * @param columns Optional column store covering the items in the same order.
+ * @param matcher Substring function used to match items and field layout of items split into fields.
+ * @param out_matches Array where matching items are stored, must fit count items.
+ * @return Number of matching items.
+ */
+static uint32_t
+match_tokens(char **tokv, uint32_t tokc, struct bm_item **items, uint32_t count, const struct columns *columns, struct matcher matcher, struct bm_item **out_matches)
+{
+    uint64_t signature = 0;
+    uint32_t min_len = 0;
+    for (uint32_t t = 0; t < tokc; ++t) {
+        uint32_t len;
+        signature |= columns_signature(tokv[t], &len);
+        min_len = (len > min_len ? len : min_len);
+    }
+
+    uint32_t f = 0;
+    struct fccursor cursor = {0};
+    for (uint32_t i = 0; i < count; ++i) {
+        if (columns && columns->item[i] == items[i]) {
+            if (tokc && ((signature & ~columns->signature[i]) || columns->len[i] < min_len))
+                continue;
+        }
+
+        const char *text = fccursor_text(&cursor, items[i]);
+
+        if (!text && tokc != 0)
+            continue;
+
+        if (tokc && text) {
+            uint32_t t;
+            if (items[i]->flags & BM_ITEM_FIELDS) {
+                for (t = 0; t < tokc && fields_contain(matcher.fields, items[i], tokv[t], matcher.fstrstr); ++t);
+            } else {
+                for (t = 0; t < tokc && matcher.fstrstr(text, tokv[t]); ++t);
+            }
+
+            if (t < tokc)
+                continue;
+        }
+
+        out_matches[f++] = items[i];
+    }
+
+    fccursor_release(&cursor);
+    return f;
+}
+
+/**
+ * Move exact and prefix matches to the front of matched items.
+ * Latest exact match comes first, then prefix matches and rest of the matches in order.
+ *
+ * @param filter Filter text the items were matched with.
+ * @param tokv Filter tokens.
+ * @param tokc Number of filter tokens.
+ * @param items Array of matched bm_item pointers, reordered in place.
+ * @param count Number of items in the array.
+ * @param matcher Comparison function used to find exact and prefix matches, items split into fields are ranked by their first matched field.
+ * @return true on success, false if out of memory and items were left in original order.
+ */
+static bool
+rank_tokens(const char *filter, char **tokv, uint32_t tokc, struct bm_item **items, uint32_t count, struct matcher matcher)
+{
+    if (!tokc || !count)
+        return true;
+
+    /* exact matches are collected from the start of head, prefix matches from the end,
+     * so that reordering them to the front does not need to move the other matches around. */
+    struct bm_item **head;
+    if (!(head = calloc(count, sizeof(struct bm_item*))))
+        return false;
+
+    const size_t flen = strlen(filter), len = strlen(tokv[0]);
+    uint32_t f = 0, e = 0, p = 0;
+    struct fccursor cursor = {0};
+    for (uint32_t i = 0; i < count; ++i) {
+        struct bm_item *item = items[i];
+        const char *text = fccursor_text(&cursor, item);
+        if ((item->flags & BM_ITEM_FIELDS) && matcher.fields && matcher.fields->nmatch)
+            text = bm_item_get_field(item, matcher.fields->match[0]);
+
+        if (text && flen == strlen(text) && !matcher.fstrncmp(filter, text, flen)) { /* exact matches */
+            head[e++] = item;
+        } else if (text && !matcher.fstrncmp(tokv[0], text, len)) { /* prefixes */
+            head[count - ++p] = item;
+        } else {
+            items[f++] = item;
+        }
+    }
+
+    fccursor_release(&cursor);
+    memmove(&items[e + p], items, f * sizeof(struct bm_item*));
+    for (uint32_t x = 0; x < e; ++x)
+        items[x] = head[e - 1 - x];
+    for (uint32_t x = 0; x < p; ++x)
+        items[e + x] = head[count - 1 - x];
+
+    free(head);
+    return true;
+}
+
 /**
  * Dmenu filterer that accepts substring function.
  *
- * @param menu bm_menu instance to filter.
- * @param addition This will be 1, if filter is same as previous filter with something appended.
- * @param fstrstr Substring function used to match items.
+ * @param filter Filter text to match items against.
+ * @param items Array of bm_item pointers to filter.
+ * @param count Number of items in the array.
+ * @param columns Optional column store covering the items in the same order.
+ * @param matcher Substring and comparison functions used to match items.
+ * @param cancel Optional flag that aborts filtering when set from another thread.
  * @param out_nmemb uint32_t reference to filtered items count.
- * @return Pointer to array of bm_item pointers.
+ * @return Pointer to array of bm_item pointers, **NULL** on failure or cancellation.
  */
 static struct bm_item**
-filter_dmenu_fun(struct bm_menu *menu, char addition, char* (*fstrstr)(const char *a, const char *b), int (*fstrncmp)(const char *a, const char *b, size_t len), uint32_t *out_nmemb)
+filter_dmenu_fun(const char *filter, struct bm_item **items, uint32_t count, const struct columns *columns, struct matcher matcher, const bool *cancel, uint32_t *out_nmemb)
 {
-    assert(menu && fstrstr && fstrncmp && out_nmemb);
+    assert(filter && out_nmemb);
     *out_nmemb = 0;
 
-    uint32_t count;
-    struct bm_item **items;
-
-    if (addition) {
-        items = bm_menu_get_filtered_items(menu, &count);
-    } else {
-        items = bm_menu_get_items(menu, &count);
-    }
-
     char *buffer = NULL;
     struct bm_item **filtered;
     if (!(filtered = calloc(count, sizeof(struct bm_item*))))
@@ -110,41 +257,30 @@ filter_dmenu_fun(struct bm_menu *menu, char addition, char* (*fstrstr)(const cha
 
     char **tokv;
     uint32_t tokc;
-    if (!(buffer = tokenize(menu, &tokv, &tokc)))
+    if (!(buffer = tokenize(filter, &tokv, &tokc)))
         goto fail;
 
-    const char *filter = menu->filter ? menu->filter : "";
-    size_t len = (tokc ? strlen(tokv[0]) : 0);
-    uint32_t i, f, e;
-    for (e = f = i = 0; i < count; ++i) {
-        struct bm_item *item = items[i];
-        if (!item->text && tokc != 0)
-            continue;
-
-        if (tokc && item->text) {
-            uint32_t t;
-            for (t = 0; t < tokc && fstrstr(item->text, tokv[t]); ++t);
-            if (t < tokc)
-                continue;
+    uint32_t f = 0;
+    for (uint32_t i = 0; i < count; i += 1024) {
+        if (cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+            free(tokv);
+            goto fail;
         }
 
-        if (tokc && item->text && strlen(filter) == strlen(item->text) && !fstrncmp(filter, item->text, strlen(filter))) { /* exact matches */
-            memmove(&filtered[1], filtered, f * sizeof(struct bm_item*));
-            filtered[0] = item;
-            e++; /* where do exact matches end */
-        } else if (tokc && item->text && !fstrncmp(tokv[0], item->text, len)) { /* prefixes */
-            memmove(&filtered[e + 1], &filtered[e], (f - e) * sizeof(struct bm_item*));
-            filtered[e] = item;
-            e++; /* where do prefix matches end */
-        } else {
-            filtered[f] = item;
-        }
-        f++; /* where do all matches end */
+        const struct columns slice = (columns ? columns_slice(columns, i) : (struct columns){0});
+        f += match_tokens(tokv, tokc, items + i, (count - i < 1024 ? count - i : 1024), (columns ? &slice : NULL), matcher, filtered + f);
     }
 
+    if (cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+        free(tokv);
+        goto fail;
+    }
+
+    rank_tokens(filter, tokv, tokc, filtered, f, matcher);
+
     free(buffer);
     free(tokv);
-    return shrink_list(&filtered, menu->items.count, (*out_nmemb = f));
+    return shrink_list(&filtered, count, (*out_nmemb = f));
 
 fail:
     free(filtered);
@@ -152,6 +288,27 @@ fail:
     return NULL;
 }
 
+/**
+ * Get the items a menu filter should run against.
+ *
+ * @param menu bm_menu instance to filter.
+ * @param addition This will be 1, if filter is same as previous filter with something appended.
+ * @param out_nmemb uint32_t reference to candidate items count.
+ * @param out_columns Reference where column store of the candidates is stored, **NULL** if there is none.
+ * @return Pointer to array of bm_item pointers.
+ */
+static struct bm_item**
+candidates(struct bm_menu *menu, bool addition, uint32_t *out_nmemb, const struct columns **out_columns)
+{
+    *out_columns = NULL;
+
+    if (addition)
+        return bm_menu_get_filtered_items(menu, out_nmemb);
+
+    *out_columns = bm_menu_columns(menu);
+    return bm_menu_get_items(menu, out_nmemb);
+}
+
 /**
  * Filter that mimics the vanilla dmenu filtering.
  *
@@ -163,7 +320,10 @@ fail:
 struct bm_item**
 bm_filter_dmenu(struct bm_menu *menu, bool addition, uint32_t *out_nmemb)
 {
-    return filter_dmenu_fun(menu, addition, strstr, strncmp, out_nmemb);
+    uint32_t count;
+    const struct columns *columns;
+    struct bm_item **items = candidates(menu, addition, &count, &columns);
+    return filter_dmenu_fun((menu->filter ? menu->filter : ""), items, count, columns, matcher_for_mode(BM_FILTER_MODE_DMENU, &menu->fields), NULL, out_nmemb);
 }
 
 /**
@@ -177,7 +337,123 @@ bm_filter_dmenu(struct bm_menu *menu, bool addition, uint32_t *out_nmemb)
 struct bm_item**
 bm_filter_dmenu_case_insensitive(struct bm_menu *menu, bool addition, uint32_t *out_nmemb)
 {
-    return filter_dmenu_fun(menu, addition, bm_strupstr, bm_strnupcmp, out_nmemb);
+    uint32_t count;
+    const struct columns *columns;
+    struct bm_item **items = candidates(menu, addition, &count, &columns);
+    return filter_dmenu_fun((menu->filter ? menu->filter : ""), items, count, columns, matcher_for_mode(BM_FILTER_MODE_DMENU_CASE_INSENSITIVE, &menu->fields), NULL, out_nmemb);
+}
+
+/**
+ * Filter using the menu's filter engine plugin.
+ *
+ * @param menu bm_menu instance to filter.
+ * @param addition This will be 1, if filter is same as previous filter with something appended.
+ * @param out_nmemb uint32_t reference to filtered items count.
+ * @return Pointer to array of bm_item pointers.
+ */
+struct bm_item**
+bm_filter_engine(struct bm_menu *menu, bool addition, uint32_t *out_nmemb)
+{
+    assert(menu && menu->filter_engine && out_nmemb);
+    *out_nmemb = 0;
+
+    uint32_t count;
+    const struct columns *columns;
+    struct bm_item **items = candidates(menu, addition, &count, &columns);
+
+    uint32_t *indices;
+    struct bm_item **filtered;
+    if (!(indices = calloc(count, sizeof(uint32_t))))
+        return NULL;
+
+    if (!(filtered = calloc(count, sizeof(struct bm_item*)))) {
+        free(indices);
+        return NULL;
+    }
+
+    uint32_t n = menu->filter_engine->api.filter((menu->filter ? menu->filter : ""), menu->filter_mode, items, count, indices), f = 0;
+    for (uint32_t i = 0; i < n && i < count; ++i) {
+        if (indices[i] < count)
+            filtered[f++] = items[indices[i]];
+    }
+
+    free(indices);
+    return shrink_list(&filtered, count, (*out_nmemb = f));
+}
+
+/**
+ * Filter an arbitrary array of items without touching menu state.
+ * Safe to call from a thread other than the one running the menu.
+ *
+ * @param mode Filter mode to use.
+ * @param fields Field layout of items split into fields, or **NULL**.
+ * @param filter Filter text to match items against.
+ * @param items Array of bm_item pointers to filter.
+ * @param count Number of items in the array.
+ * @param columns Optional column store covering the items in the same order.
+ * @param cancel Optional flag that aborts filtering when set from another thread.
+ * @param out_nmemb uint32_t reference to filtered items count.
+ * @return Pointer to array of bm_item pointers, **NULL** on failure or cancellation.
+ */
+struct bm_item**
+bm_filter_items(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count, const struct columns *columns, const bool *cancel, uint32_t *out_nmemb)
+{
+    return filter_dmenu_fun(filter, items, count, columns, matcher_for_mode(mode, fields), cancel, out_nmemb);
+}
+
+/**
+ * Collect matching items without ranking them.
+ * Used to filter in slices, bm_filter_rank should be called once all slices are matched.
+ *
+ * @param mode Filter mode to use.
+ * @param fields Field layout of items split into fields, or **NULL**.
+ * @param filter Filter text to match items against.
+ * @param items Array of bm_item pointers to match.
+ * @param count Number of items in the array.
+ * @param columns Optional column store covering the items in the same order.
+ * @param out_matches Array where matching items are stored, must fit count items.
+ * @return Number of matching items.
+ */
+uint32_t
+bm_filter_match(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count, const struct columns *columns, struct bm_item **out_matches)
+{
+    assert(filter && out_matches);
+
+    char **tokv, *buffer;
+    uint32_t tokc;
+    if (!(buffer = tokenize(filter, &tokv, &tokc)))
+        return 0;
+
+    uint32_t f = match_tokens(tokv, tokc, items, count, columns, matcher_for_mode(mode, fields), out_matches);
+
+    free(buffer);
+    free(tokv);
+    return f;
+}
+
+/**
+ * Reorder matched items in place so exact and prefix matches come first.
+ *
+ * @param mode Filter mode to use.
+ * @param fields Field layout of items split into fields, or **NULL**.
+ * @param filter Filter text the items were matched with.
+ * @param items Array of matched bm_item pointers.
+ * @param count Number of items in the array.
+ */
+void
+bm_filter_rank(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count)
+{
+    assert(filter);
+
+    char **tokv, *buffer;
+    uint32_t tokc;
+    if (!(buffer = tokenize(filter, &tokv, &tokc)))
+        return;
+
+    rank_tokens(filter, tokv, tokc, items, count, matcher_for_mode(mode, fields));
+
+    free(buffer);
+    free(tokv);
 }
 
 /* vim: set ts=8 sw=4 tw=0 :*/
@@ -0,0 +1,264 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Number of entries between restart points.
+ * Entries at restart points share no prefix, so decoding can start from them.
+ */
+#define BLOCK_ENTRIES 16
+
+static size_t
+put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    for (; value >= 0x80; value >>= 7)
+        out[n++] = (uint8_t)(value | 0x80);
+
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t
+get_varint(const uint8_t *in, uint32_t *out_value)
+{
+    size_t n = 0;
+    uint32_t value = 0;
+    for (uint32_t shift = 0; in[n] & 0x80; shift += 7)
+        value |= (uint32_t)(in[n++] & 0x7f) << shift;
+
+    *out_value = value | ((uint32_t)in[n] << (7 * n));
+    return n + 1;
+}
+
+static struct fcstore*
+store_of(const struct bm_item *item)
+{
+    return (struct fcstore*)(void*)item->text;
+}
+
+/**
+ * Encode texts, each entry is stored as the length of the prefix shared with the
+ * previous entry and the length of the rest as varints, followed by the rest.
+ *
+ * @param texts Texts to encode, sorted texts compress best. **NULL** is stored as empty text.
+ * @param count Number of texts.
+ * @return Store for the texts, **NULL** on failure.
+ */
+struct fcstore*
+fcstore_new(const char **texts, uint32_t count)
+{
+    assert(texts);
+
+    struct fcstore *store;
+    if (!(store = calloc(1, sizeof(struct fcstore))))
+        return NULL;
+
+    if (!(store->restarts = calloc((count + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES + 1, sizeof(size_t))))
+        goto fail;
+
+    const char *prev = "";
+    for (uint32_t i = 0; i < count; ++i) {
+        const char *text = (texts[i] ? texts[i] : "");
+        size_t len = strlen(text), shared = 0;
+
+        if (len > UINT32_MAX - 1)
+            goto fail;
+
+        if (i % BLOCK_ENTRIES == 0) {
+            store->restarts[i / BLOCK_ENTRIES] = store->len;
+        } else {
+            for (; prev[shared] && prev[shared] == text[shared]; ++shared);
+        }
+
+        /* two varints take at most 10 bytes */
+        if (store->allocated - store->len < len - shared + 10) {
+            size_t allocated = (store->allocated ? store->allocated : 4096);
+            while (allocated - store->len < len - shared + 10)
+                allocated *= 2;
+
+            void *tmp;
+            if (!(tmp = realloc(store->data, allocated)))
+                goto fail;
+
+            store->data = tmp;
+            store->allocated = allocated;
+        }
+
+        store->len += put_varint(store->data + store->len, (uint32_t)shared);
+        store->len += put_varint(store->data + store->len, (uint32_t)(len - shared));
+        memcpy(store->data + store->len, text + shared, len - shared);
+        store->len += len - shared;
+
+        store->max_len = (len > store->max_len ? (uint32_t)len : store->max_len);
+        store->count++;
+        prev = text;
+    }
+
+    /* the store is not appended to afterwards */
+    void *tmp;
+    if (store->len && (tmp = realloc(store->data, store->len))) {
+        store->data = tmp;
+        store->allocated = store->len;
+    }
+
+    return store;
+
+fail:
+    fcstore_free(store);
+    return NULL;
+}
+
+void
+fcstore_free(struct fcstore *store)
+{
+    if (!store)
+        return;
+
+    fccursor_release(&store->cursor);
+    list_free_items(&store->strings, free);
+    ptrmap_release(&store->decoded);
+    free(store->restarts);
+    free(store->data);
+    free(store);
+}
+
+/**
+ * Make item refer to entry of store as its text.
+ */
+void
+fcstore_bind(struct fcstore *store, struct bm_item *item, uint32_t index)
+{
+    assert(store && item && index < store->count);
+    item->text = (char*)(void*)store;
+    item->code = index;
+    item->flags |= BM_ITEM_TEXT_CODED;
+}
+
+/**
+ * Decode text of a front coded item for bm_item_get_text.
+ * The text is decoded once, and stays valid as long as the store.
+ */
+const char*
+fcstore_text(const struct bm_item *item)
+{
+    assert(item && (item->flags & BM_ITEM_TEXT_CODED));
+
+    struct fcstore *store = store_of(item);
+
+    uint32_t index;
+    if (ptrmap_get(&store->decoded, item, &index))
+        return store->strings.items[index];
+
+    /* empty text is NULL, like with bm_item_set_text */
+    const char *text;
+    char *copy = NULL;
+    if (!(text = fccursor_text(&store->cursor, item)) || !*text || !(copy = bm_strdup(text)))
+        return NULL;
+
+    if (!list_add_item(&store->strings, copy))
+        goto fail;
+
+    if (!ptrmap_put(&store->decoded, item, store->strings.count - 1)) {
+        store->strings.count--;
+        goto fail;
+    }
+
+    return copy;
+
+fail:
+    free(copy);
+    return NULL;
+}
+
+size_t
+fcstore_memory_usage(const struct fcstore *store)
+{
+    assert(store);
+
+    size_t size = sizeof(struct fcstore) + store->allocated;
+    size += sizeof(size_t) * ((store->count + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES + 1);
+    size += (store->cursor.buf ? store->max_len + 1 : 0);
+    size += ((size_t)sizeof(void*) + sizeof(uint32_t)) * store->decoded.size;
+    size += sizeof(void*) * store->strings.allocated;
+
+    for (uint32_t i = 0; i < store->strings.count; ++i)
+        size += strlen(store->strings.items[i]) + 1;
+
+    return size;
+}
+
+static size_t
+decode_entry(const struct fcstore *store, size_t offset, char *buf)
+{
+    uint32_t shared, rest;
+    offset += get_varint(store->data + offset, &shared);
+    offset += get_varint(store->data + offset, &rest);
+    memcpy(buf + shared, store->data + offset, rest);
+    buf[shared + rest] = 0;
+    return offset + rest;
+}
+
+/**
+ * Get text of item, decoding it if the item is front coded.
+ *
+ * Consecutive entries of a store are decoded incrementally, so scanning items
+ * in store order only decodes the part not shared with the previous entry.
+ * Any other entry is decoded from the closest restart point before it.
+ *
+ * @param cursor Decoding state, zero initialized before first use.
+ * @param item Item to get text of.
+ * @return Text of the item, valid until the next call with the cursor. **NULL** if the item has no text or out of memory.
+ */
+const char*
+fccursor_text(struct fccursor *cursor, const struct bm_item *item)
+{
+    assert(cursor && item);
+
+    if (!(item->flags & BM_ITEM_TEXT_CODED))
+        return item->text;
+
+    const struct fcstore *store = store_of(item);
+    if (cursor->store != store || !cursor->buf) {
+        fccursor_release(cursor);
+
+        if (!(cursor->buf = malloc((size_t)store->max_len + 1)))
+            return NULL;
+
+        cursor->store = store;
+        cursor->valid = false;
+    }
+
+    const uint32_t index = item->code;
+    if (cursor->valid && cursor->index == index)
+        return cursor->buf;
+
+    uint32_t i;
+    size_t offset;
+    if (cursor->valid && cursor->index < index && cursor->index / BLOCK_ENTRIES == index / BLOCK_ENTRIES) {
+        i = cursor->index + 1;
+        offset = cursor->next;
+    } else {
+        i = index - index % BLOCK_ENTRIES;
+        offset = store->restarts[index / BLOCK_ENTRIES];
+    }
+
+    for (; i <= index; ++i)
+        offset = decode_entry(store, offset, cursor->buf);
+
+    cursor->index = index;
+    cursor->next = offset;
+    cursor->valid = true;
+    return cursor->buf;
+}
+
+void
+fccursor_release(struct fccursor *cursor)
+{
+    assert(cursor);
+    free(cursor->buf);
+    memset(cursor, 0, sizeof(struct fccursor));
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -0,0 +1,186 @@
+#include "internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#define INDEX_VERSION 1
+
+static const char index_magic[8] = "BMINDEX";
+
+/**
+ * Header of an item index file.
+ *
+ * Followed by offset of each text in the text section as uint64_t, signature of each text
+ * as uint64_t, length of each text as uint32_t and the null terminated texts.
+ * Values are in host byte order, so an index is read on the kind of machine that wrote it.
+ */
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t text_size;
+};
+
+bool
+bm_write_index(const char *path, const char **texts, uint32_t count)
+{
+    assert(path && (texts || !count));
+
+    FILE *f = NULL;
+    char *tmp = NULL;
+    uint64_t *signatures = NULL;
+    uint32_t *lens = NULL;
+
+    if (!(signatures = calloc(count + 1, sizeof(uint64_t))) || !(lens = calloc(count + 1, sizeof(uint32_t))))
+        goto fail;
+
+    struct index_header header = { .version = INDEX_VERSION, .count = count };
+    memcpy(header.magic, index_magic, sizeof(header.magic));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        signatures[i] = columns_signature(texts[i], &lens[i]);
+        header.text_size += lens[i] + 1;
+    }
+
+    /* readers of the old index keep their mapping, the new one replaces it at once */
+    if (!(tmp = malloc(strlen(path) + sizeof(".tmp"))))
+        goto fail;
+
+    sprintf(tmp, "%s.tmp", path);
+
+    if (!(f = fopen(tmp, "wb")))
+        goto fail;
+
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+    uint64_t offset = 0;
+    for (uint32_t i = 0; ok && i < count; offset += lens[i++] + 1)
+        ok = (fwrite(&offset, sizeof(offset), 1, f) == 1);
+
+    ok = ok && (fwrite(signatures, sizeof(uint64_t), count, f) == count);
+    ok = ok && (fwrite(lens, sizeof(uint32_t), count, f) == count);
+
+    for (uint32_t i = 0; ok && i < count; ++i)
+        ok = (fwrite((texts[i] ? texts[i] : ""), 1, lens[i] + 1, f) == lens[i] + 1);
+
+    if (fclose(f) != 0 || !ok) {
+        f = NULL;
+        unlink(tmp);
+        goto fail;
+    }
+
+    f = NULL;
+
+    if (rename(tmp, path) != 0) {
+        unlink(tmp);
+        goto fail;
+    }
+
+    free(tmp);
+    free(signatures);
+    free(lens);
+    return true;
+
+fail:
+    if (f) {
+        fclose(f);
+        unlink(tmp);
+    }
+
+    free(tmp);
+    free(signatures);
+    free(lens);
+    return false;
+}
+
+bool
+bm_menu_set_items_from_index(struct bm_menu *menu, const char *path)
+{
+    assert(menu && path);
+
+    bm_menu_free_items(menu);
+
+    int fd;
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(struct index_header) || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    struct bm_buffer *owned;
+    if (!(owned = calloc(1, sizeof(struct bm_buffer)))) {
+        munmap(data, size);
+        return false;
+    }
+
+    *owned = (struct bm_buffer){ .data = data, .len = size, .ownership = BM_BUFFER_MUNMAP };
+
+    if (!list_add_item(&menu->buffers, owned)) {
+        munmap(data, size);
+        free(owned);
+        return false;
+    }
+
+    const struct index_header *header = data;
+    if (memcmp(header->magic, index_magic, sizeof(header->magic)) || header->version != INDEX_VERSION)
+        return false;
+
+    const uint32_t count = header->count;
+    const size_t tables = sizeof(struct index_header) + (sizeof(uint64_t) * 2 + sizeof(uint32_t)) * (size_t)count;
+    if (tables > size || header->text_size != size - tables)
+        return false;
+
+    const uint64_t *offsets = (const uint64_t*)(header + 1);
+    const uint64_t *signatures = offsets + count;
+    const uint32_t *lens = (const uint32_t*)(signatures + count);
+    const char *text = (const char*)data + tables;
+
+    /* every text must end within the file */
+    if (count > 0 && (header->text_size == 0 || text[header->text_size - 1] != 0))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (offsets[i] >= header->text_size)
+            return false;
+    }
+
+    if (!count)
+        return true;
+
+    struct bm_item *items;
+    if (!(items = arena_alloc(&menu->arena, sizeof(struct bm_item) * count, sizeof(void*))))
+        return false;
+
+    if (!bm_menu_reserve_items(menu, count))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        items[i] = (struct bm_item){ .text = (char*)text + offsets[i], .flags = BM_ITEM_ARENA | BM_ITEM_TEXT_BORROWED };
+        menu->items.items[menu->items.count++] = &items[i];
+    }
+
+    /* filtering starts with the column store filled from the index */
+    columns_seed(&menu->columns, (struct bm_item**)menu->items.items, signatures, lens, count);
+
+    if (menu->unique.enabled)
+        unique_tail(menu, 0);
+
+    return true;
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -0,0 +1,187 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+
+/**
+ * Smallest buffer worth splitting between threads.
+ */
+#define INGEST_MIN_SIZE (8 * 1024 * 1024)
+
+/**
+ * Smallest part of the buffer given to one thread.
+ */
+#define INGEST_MIN_CHUNK (1024 * 1024)
+
+/**
+ * Upper bound of threads used.
+ */
+#define INGEST_MAX_THREADS 64
+
+/**
+ * Part of the buffer handled by one thread, starts at a line and ends after a delimiter.
+ */
+struct chunk {
+    pthread_t thread;
+    bool running;
+
+    char *start, *end;
+    char delimiter;
+
+    /**
+     * Number of lines in the chunk, and position of its first line among the new items.
+     */
+    uint32_t count, first;
+
+    /**
+     * Where the items are built, columns is **NULL** if the column store is not filled.
+     */
+    struct bm_item *items;
+    struct bm_item **list;
+    struct columns *columns;
+    uint32_t base;
+};
+
+static void*
+count_lines(void *arg)
+{
+    struct chunk *chunk = arg;
+    chunk->count = 0;
+    for (const char *s = chunk->start; (s = memchr(s, chunk->delimiter, chunk->end - s)); ++s)
+        chunk->count++;
+
+    return NULL;
+}
+
+static void*
+build_items(void *arg)
+{
+    struct chunk *chunk = arg;
+    struct columns *columns = chunk->columns;
+
+    uint32_t i = chunk->first;
+    for (char *s = chunk->start, *d; (d = memchr(s, chunk->delimiter, chunk->end - s)); s = d + 1, ++i) {
+        *d = 0;
+
+        struct bm_item *item = &chunk->items[i];
+        *item = (struct bm_item){ .text = s, .flags = BM_ITEM_ARENA | BM_ITEM_TEXT_BORROWED };
+        chunk->list[chunk->base + i] = item;
+
+        if (columns) {
+            const uint32_t row = chunk->base + i;
+            columns->item[row] = item;
+            columns->revision[row] = 0;
+            columns->signature[row] = columns_signature(s, &columns->len[row]);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Run fun for every chunk, on other threads where possible and the rest on the calling thread.
+ */
+static void
+run_chunks(struct chunk *chunks, uint32_t nchunks, void* (*fun)(void *arg))
+{
+    for (uint32_t i = 1; i < nchunks; ++i)
+        chunks[i].running = !pthread_create(&chunks[i].thread, NULL, fun, &chunks[i]);
+
+    fun(&chunks[0]);
+
+    for (uint32_t i = 1; i < nchunks; ++i) {
+        if (chunks[i].running) {
+            pthread_join(chunks[i].thread, NULL);
+            chunks[i].running = false;
+        } else {
+            fun(&chunks[i]);
+        }
+    }
+}
+
+/**
+ * Append items for lines of a large buffer, splitting the work between all cores.
+ * Items are appended in the order of the lines, with the column store filled along.
+ *
+ * @param menu bm_menu instance where to append the items.
+ * @param buffer Lines, each terminated by delimiter which is replaced by a null terminator.
+ * @param len Length of the buffer in bytes.
+ * @param delimiter Byte that terminates lines.
+ * @return true if the items were appended, false if the buffer was left as is because it is too small to split or out of memory.
+ */
+bool
+ingest_lines(struct bm_menu *menu, char *buffer, size_t len, char delimiter)
+{
+    assert(menu && (buffer || !len));
+    assert(!len || buffer[len - 1] == delimiter);
+
+    const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t nchunks = (ncpu > INGEST_MAX_THREADS ? INGEST_MAX_THREADS : (ncpu > 0 ? ncpu : 1));
+    if (len / INGEST_MIN_CHUNK < nchunks)
+        nchunks = len / INGEST_MIN_CHUNK;
+
+    if (len < INGEST_MIN_SIZE || nchunks < 2)
+        return false;
+
+    struct chunk chunks[INGEST_MAX_THREADS] = {0};
+
+    /* chunks end after the first delimiter past an even split, so lines are never divided */
+    char *s = buffer, *end = buffer + len;
+    uint32_t n = 0;
+    for (; n < nchunks && s < end; ++n) {
+        char *e = (n + 1 < nchunks ? buffer + len / nchunks * (n + 1) : end);
+        if (e < s)
+            e = s;
+
+        char *d = (e < end ? memchr(e, delimiter, end - e) : NULL);
+        e = (d ? d + 1 : end);
+        chunks[n] = (struct chunk){ .start = s, .end = e, .delimiter = delimiter };
+        s = e;
+    }
+
+    run_chunks(chunks, n, count_lines);
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        chunks[i].first = (uint32_t)total;
+        total += chunks[i].count;
+    }
+
+    if (total == 0 || total > UINT32_MAX - menu->items.count)
+        return false;
+
+    struct bm_item *items;
+    if (!(items = arena_alloc(&menu->arena, sizeof(struct bm_item) * total, sizeof(void*))))
+        return false;
+
+    items_will_grow(menu);
+
+    if (!list_reserve(&menu->items, menu->items.count + total))
+        return false;
+
+    /* the column store is filled along only if it covers the existing items, otherwise it is built when filtering */
+    struct columns *columns = &menu->columns;
+    const uint32_t base = menu->items.count;
+    if (columns->count != base || !columns_reserve(columns, base + total))
+        columns = NULL;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        chunks[i].items = items;
+        chunks[i].list = (struct bm_item**)menu->items.items;
+        chunks[i].columns = columns;
+        chunks[i].base = base;
+    }
+
+    run_chunks(chunks, n, build_items);
+
+    menu->items.count += total;
+
+    if (columns)
+        columns->count = menu->items.count;
+
+    return true;
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
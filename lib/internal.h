@@ -17,10 +17,22 @@ extern char *secure_getenv(const char *name);
 
 #include <stddef.h> /* for size_t */
 #include <stdarg.h>
+#include <pthread.h>
 
 //minimum allowed window width when setting margin
 #define WINDOW_MIN_WIDTH 80
 
+//number of speculatively filtered result sets kept per menu
+#define BM_SPECULATE_SLOTS 4
+
+//below this many candidates filtering is cheap enough to not speculate
+#define BM_SPECULATE_MIN_ITEMS 10000
+
+//bytes of text storage allocated inline with heap items, texts shorter than this need no allocation of their own
+#define BM_ITEM_INLINE_TEXT 24
+
+struct speculation;
+
 /**
  * Destructor function pointer for some list calls.
  */
@@ -46,6 +58,83 @@ struct list {
     uint32_t allocated;
 };
 
+/**
+ * Open addressing hash map from pointers to indices.
+ */
+struct ptrmap {
+    /**
+     * Keys of the slots, **NULL** for empty slot.
+     */
+    const void **keys;
+
+    /**
+     * Values of the slots.
+     */
+    uint32_t *values;
+
+    /**
+     * Number of keys and number of slots, always zero or power of two.
+     */
+    uint32_t count, size;
+};
+
+/**
+ * Open addressing hash set of items by text.
+ */
+struct textset {
+    /**
+     * Items of the slots, **NULL** for empty slot.
+     */
+    const struct bm_item **items;
+
+    /**
+     * Hash of the text of each slot's item.
+     */
+    uint64_t *hashes;
+
+    /**
+     * Number of items and number of slots, always zero or power of two.
+     */
+    uint32_t count, size;
+};
+
+/**
+ * Bump allocator, memory is only released all at once.
+ */
+struct arena {
+    /**
+     * Most recently allocated block, blocks are linked to the previous ones.
+     */
+    struct arena_block *block;
+
+    /**
+     * Total bytes allocated for blocks.
+     */
+    size_t size;
+};
+
+/**
+ * Items pushed or retracted by a producer thread, waiting to be applied by the menu thread.
+ */
+struct bm_batch {
+    /**
+     * Next batch in the queue.
+     */
+    struct bm_batch *next;
+
+    /**
+     * Whether items are retracted instead of pushed.
+     */
+    bool retract;
+
+    /**
+     * Number of items.
+     */
+    uint32_t count;
+
+    struct bm_item *items[];
+};
+
 /**
  * Internal render api struct.
  * Renderers should be able to fill this one as they see fit.
@@ -140,6 +229,11 @@ struct render_api {
      */
     void (*set_overlap)(const struct bm_menu *menu, bool overlap);
 
+    /**
+     * Bytes held in client side buffers
+     */
+    size_t (*get_memory_usage)(const struct bm_menu *menu);
+
     /**
      * Version of the plugin.
      * Should match BM_PLUGIN_VERSION or failure.
@@ -184,6 +278,236 @@ struct bm_renderer {
     struct render_api api;
 };
 
+/**
+ * Internal filter api struct.
+ * Filter engines should fill this one in their register_filter function.
+ */
+struct filter_api {
+    /**
+     * Match items against query.
+     * Indices of matching items are stored to out_indices in the order they should be listed,
+     * out_indices has room for count indices.
+     * Returns number of matching items.
+     */
+    uint32_t (*filter)(const char *query, enum bm_filter_mode mode, struct bm_item *const *items, uint32_t count, uint32_t *out_indices);
+
+    /**
+     * Version of the plugin.
+     * Should match BM_PLUGIN_VERSION or failure.
+     */
+    const char *version;
+
+    /**
+     * Matches of a query are always a subset of matches of any prefix of that query.
+     * Allows filtering only the previous matches when the query grows.
+     */
+    bool incremental;
+};
+
+/**
+ * Internal bm_filter_engine struct.
+ */
+struct bm_filter_engine {
+    /**
+     * Name of the filter engine.
+     */
+    char *name;
+
+    /**
+     * File path of the filter engine.
+     */
+    char *file;
+
+    /**
+     * Open handle to the plugin file of this filter engine.
+     * Stays open once activated.
+     */
+    void *handle;
+
+    /**
+     * API
+     */
+    struct filter_api api;
+};
+
+/**
+ * Column store of item texts, kept in the same order as the items.
+ * Lets filtering stream through contiguous arrays instead of dereferencing every bm_item.
+ */
+struct columns {
+    /**
+     * Item each row was built from.
+     * Rows whose item no longer is at the same position, e.g. after sorting the items array, are not used.
+     */
+    const struct bm_item **item;
+
+    /**
+     * Revision of each item's text the row was computed from, see item_text_revision.
+     * Texts are read from the items when matched, so a changed text is never read from a stale row.
+     */
+    uint16_t *revision;
+
+    /**
+     * Length of each text in bytes.
+     */
+    uint32_t *len;
+
+    /**
+     * Bitmask of the case folded bytes of each text, see columns_signature.
+     * An item can only match a filter whose signature bits are all set in the item's signature.
+     */
+    uint64_t *signature;
+
+    /**
+     * Number of items covered and number of allocated entries per column.
+     */
+    uint32_t count, allocated;
+
+    /**
+     * Value of item_text_revision when the rows were last checked against their items.
+     */
+    uint32_t checked;
+};
+
+/**
+ * Buffer that item texts point into.
+ */
+struct bm_buffer {
+    /**
+     * Start of the buffer.
+     */
+    char *data;
+
+    /**
+     * Length of the buffer in bytes.
+     */
+    size_t len;
+
+    /**
+     * How the buffer is released with the items.
+     */
+    enum bm_buffer_ownership ownership;
+};
+
+/**
+ * Storage flags of bm_item.
+ */
+enum bm_item_flags {
+    /**
+     * Item struct is allocated from a menu arena and released with it.
+     */
+    BM_ITEM_ARENA = 1<<0,
+
+    /**
+     * Text is not owned by the item and must not be freed with it.
+     */
+    BM_ITEM_TEXT_BORROWED = 1<<1,
+
+    /**
+     * Text is an entry of a front coded store, see fcstore.
+     * The text member points to the store and code is the entry, use bm_item_get_text or fccursor_text.
+     */
+    BM_ITEM_TEXT_CODED = 1<<2,
+
+    /**
+     * Text is stored right after the item struct, in the same allocation.
+     * See inline_size.
+     */
+    BM_ITEM_TEXT_INLINE = 1<<3,
+
+    /**
+     * Text is split into fields in place, each field is null terminated.
+     * Field count and offsets from text follow the item struct, see bm_item_get_field.
+     */
+    BM_ITEM_FIELDS = 1<<4,
+};
+
+/**
+ * Field layout of items split into fields, see bm_menu_set_fields.
+ */
+struct fields {
+    /**
+     * Byte separating fields, 0 if items are not split.
+     */
+    char separator;
+
+    /**
+     * Fields matched by the filter, every field if there are none.
+     */
+    uint32_t *match, nmatch;
+
+    /**
+     * Fields joined for display, every field if there are none.
+     */
+    uint32_t *display, ndisplay;
+
+    /**
+     * Display text of the last item joined by bm_menu_get_item_display_text.
+     */
+    char *scratch;
+    size_t scratch_size;
+};
+
+/**
+ * Decoding state for reading entries of a front coded store.
+ */
+struct fccursor {
+    /**
+     * Store the cursor is decoding.
+     */
+    const struct fcstore *store;
+
+    /**
+     * Entry decoded in buf and offset of the entry after it.
+     */
+    uint32_t index;
+    size_t next;
+    bool valid;
+
+    /**
+     * Room for the longest entry of store.
+     */
+    char *buf;
+};
+
+/**
+ * Front coded text store.
+ * Entries store only the part not shared with the previous entry, which is compact for sorted texts.
+ */
+struct fcstore {
+    /**
+     * Encoded entries.
+     */
+    uint8_t *data;
+
+    /**
+     * Bytes used and allocated in data.
+     */
+    size_t len, allocated;
+
+    /**
+     * Offsets of the entries decoding can start from.
+     */
+    size_t *restarts;
+
+    /**
+     * Number of entries and length of the longest one.
+     */
+    uint32_t count, max_len;
+
+    /**
+     * Decoding state of bm_item_get_text.
+     */
+    struct fccursor cursor;
+
+    /**
+     * Texts decoded by bm_item_get_text, kept for the lifetime of the store.
+     * Maps items to indices of strings.
+     */
+    struct ptrmap decoded;
+    struct list strings;
+};
+
 /**
  * Internal bm_item struct that is not exposed to public.
  * Represents a single item in menu.
@@ -200,6 +524,26 @@ struct bm_item {
      * Matching will be done against this text as well.
      */
     char *text;
+
+    /**
+     * Storage of the item, see bm_item_flags.
+     */
+    uint8_t flags;
+
+    /**
+     * Bytes of text storage allocated right after the item struct, 0 if none.
+     */
+    uint8_t inline_size;
+
+    /**
+     * Incremented whenever bm_item_set_text changes the text, lets caches of the text notice.
+     */
+    uint16_t revision;
+
+    /**
+     * Entry of front coded text, see BM_ITEM_TEXT_CODED.
+     */
+    uint32_t code;
 };
 
 /**
@@ -240,15 +584,75 @@ struct bm_menu {
     void *userdata;
 
     /**
-     * Underlying renderer access.
+     * Underlying renderer access, **NULL** until the renderer is constructed on first render.
      */
     struct bm_renderer *renderer;
 
+    /**
+     * Name of the renderer passed to bm_menu_new, **NULL** for any GUI renderer.
+     */
+    char *requested_renderer;
+
+    /**
+     * Set when no renderer could be constructed, so it is not tried on every render.
+     */
+    bool renderer_failed;
+
+    /**
+     * Thread constructing the renderer, see bm_menu_start_renderer.
+     * Joined before anything else uses the renderer.
+     */
+    pthread_t renderer_thread;
+    bool renderer_starting;
+
+    /**
+     * Filter engine used instead of filter_mode's built-in filter, or **NULL**.
+     */
+    struct bm_filter_engine *filter_engine;
+
     /**
      * Items contained in menu instance.
      */
     struct list items;
 
+    /**
+     * Storage for items created with bm_menu_new_item.
+     */
+    struct arena arena;
+
+    /**
+     * Buffers of items loaded with bm_menu_set_items_from_buffer.
+     */
+    struct list buffers;
+
+    /**
+     * Front coded stores of items added with bm_menu_add_items_front_coded.
+     */
+    struct list stores;
+
+    /**
+     * Field layout of items loaded with bm_menu_set_items_from_buffer.
+     */
+    struct fields fields;
+
+    /**
+     * Column store of items, extended lazily before filtering.
+     */
+    struct columns columns;
+
+    /**
+     * Duplicate items dropped when loading or pushing items, see bm_menu_set_unique.
+     */
+    struct {
+        bool enabled;
+
+        /**
+         * Texts of the items before index covered, built again when it does not match the items.
+         */
+        struct textset set;
+        uint32_t covered;
+    } unique;
+
     /**
      * Filtered/displayed items contained in menu instance.
      */
@@ -259,6 +663,30 @@ struct bm_menu {
      */
     struct list selection;
 
+    /**
+     * Set of selected items for constant time membership checks.
+     * Must be kept in sync with selection, use the selection_* functions.
+     */
+    struct ptrmap selected;
+
+    /**
+     * Positions of the items returned by bm_menu_get_filtered_items, built on first lookup.
+     */
+    struct {
+        struct ptrmap map;
+
+        /**
+         * Array and count the map was built for.
+         */
+        const void *items;
+        uint32_t count;
+
+        /**
+         * Cleared when the array may have changed in place.
+         */
+        bool valid;
+    } positions;
+
     /**
      * Menu instance title.
      */
@@ -310,6 +738,73 @@ struct bm_menu {
      */
     char *old_filter;
 
+    /**
+     * Result sets filtered ahead of time for likely next filters.
+     */
+    struct speculation *speculation;
+
+    /**
+     * Filtering that did not fit in the latency budget.
+     * Continued on following bm_menu_filter calls until the result is complete.
+     */
+    struct {
+        /**
+         * Filter being computed, **NULL** when nothing is pending.
+         */
+        char *filter;
+
+        /**
+         * Items being matched against the filter.
+         */
+        struct bm_item **candidates;
+
+        /**
+         * Column store of the candidates, or **NULL**.
+         */
+        const struct columns *columns;
+
+        /**
+         * Number of candidates and index of the next candidate to match.
+         */
+        uint32_t count, next;
+
+        /**
+         * Whether candidates is a previous filtered list that must be freed once done.
+         */
+        bool owned;
+
+        /**
+         * Whether a pass was cancelled or left partial by changed items, the next bm_menu_filter filters again.
+         */
+        bool restart;
+    } pending;
+
+    /**
+     * Number of filtered items once the last filter pass completed, UINT32_MAX before any pass has.
+     * Shown while a pass is pending.
+     */
+    uint32_t filtered_count;
+
+    /**
+     * Time budget in milliseconds for a single filter pass and render, 0 for unbounded.
+     */
+    uint32_t latency_budget;
+
+    /**
+     * Items pushed by producer threads.
+     */
+    struct {
+        /**
+         * Batches in reverse order of pushing, accessed only atomically.
+         */
+        struct bm_batch *head;
+
+        /**
+         * Pipe written after each push, so renderers can wake up for it.
+         */
+        int wake[2];
+    } incoming;
+
     /**
      * Used when selecting the filter text (ex. SHIFT_RETURN)
      */
@@ -459,12 +954,65 @@ struct bm_menu {
     uint32_t vim_last_key;
 };
 
+/* menu.c */
+const struct columns* bm_menu_columns(struct bm_menu *menu);
+void items_will_grow(struct bm_menu *menu);
+bool selection_add(struct bm_menu *menu, struct bm_item *item);
+void selection_remove(struct bm_menu *menu, struct bm_item *item);
+void selection_clear(struct bm_menu *menu);
+
+/* item.c */
+uint32_t item_text_revision(void);
+
 /* library.c */
 bool bm_renderer_activate(struct bm_renderer *renderer, struct bm_menu *menu);
+bool bm_filter_engine_activate(struct bm_filter_engine *engine);
 
 /* filter.c */
 struct bm_item** bm_filter_dmenu(struct bm_menu *menu, bool addition, uint32_t *out_nmemb);
 struct bm_item** bm_filter_dmenu_case_insensitive(struct bm_menu *menu, bool addition, uint32_t *out_nmemb);
+struct bm_item** bm_filter_engine(struct bm_menu *menu, bool addition, uint32_t *out_nmemb);
+struct bm_item** bm_filter_items(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count, const struct columns *columns, const bool *cancel, uint32_t *out_nmemb);
+uint32_t bm_filter_match(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count, const struct columns *columns, struct bm_item **out_matches);
+void bm_filter_rank(enum bm_filter_mode mode, const struct fields *fields, const char *filter, struct bm_item **items, uint32_t count);
+
+/* speculate.c */
+void bm_speculate_start(struct bm_menu *menu, const char *base, struct bm_item **candidates, uint32_t count, const struct columns *columns);
+bool bm_speculate_take(struct bm_menu *menu, struct bm_item ***out_items, uint32_t *out_nmemb);
+void bm_speculate_reset(struct bm_menu *menu);
+void bm_speculate_free(struct bm_menu *menu);
+size_t bm_speculate_memory_usage(const struct bm_menu *menu);
+
+/* columns.c */
+uint64_t columns_signature(const char *text, uint32_t *out_len);
+bool columns_update(struct columns *columns, struct bm_item **items, uint32_t count);
+bool columns_reserve(struct columns *columns, uint32_t count);
+void columns_move(struct columns *columns, uint32_t to, uint32_t from);
+bool columns_seed(struct columns *columns, struct bm_item **items, const uint64_t *signatures, const uint32_t *lens, uint32_t count);
+void columns_invalidate(struct columns *columns);
+void columns_release(struct columns *columns);
+struct columns columns_slice(const struct columns *columns, uint32_t offset);
+
+/* frontcode.c */
+struct fcstore* fcstore_new(const char **texts, uint32_t count);
+void fcstore_free(struct fcstore *store);
+void fcstore_bind(struct fcstore *store, struct bm_item *item, uint32_t index);
+const char* fcstore_text(const struct bm_item *item);
+size_t fcstore_memory_usage(const struct fcstore *store);
+const char* fccursor_text(struct fccursor *cursor, const struct bm_item *item);
+void fccursor_release(struct fccursor *cursor);
+
+/* ingest.c */
+bool ingest_lines(struct bm_menu *menu, char *buffer, size_t len, char delimiter);
+
+/* unique.c */
+void unique_tail(struct bm_menu *menu, uint32_t first);
+size_t unique_memory_usage(const struct bm_menu *menu);
+void textset_release(struct textset *set);
+
+/* arena.c */
+void* arena_alloc(struct arena *arena, size_t size, size_t align);
+void arena_release(struct arena *arena);
 
 /* list.c */
 void list_free_list(struct list *list);
@@ -473,6 +1021,7 @@ void* list_get_items(const struct list *list, uint32_t *out_nmemb);
 bool list_set_items_no_copy(struct list *list, void *items, uint32_t nmemb);
 bool list_set_items(struct list *list, const void *items, uint32_t nmemb, list_free_fun destructor);
 bool list_grow(struct list *list, uint32_t step);
+bool list_reserve(struct list *list, uint32_t nmemb);
 bool list_add_item_at(struct list *list, void *item, uint32_t index);
 bool list_add_item(struct list *list, void *item);
 bool list_remove_item_at(struct list *list, uint32_t index);
@@ -499,6 +1048,10 @@ size_t bm_utf8_rune_remove(char *string, size_t start, size_t *out_rune_width);
 size_t bm_utf8_rune_insert(char **string, size_t *bufSize, size_t start, const char *rune, uint32_t u8len, size_t *out_rune_width);
 size_t bm_unicode_insert(char **string, size_t *bufSize, size_t start, uint32_t unicode, size_t *out_rune_width);
 bool bm_menu_item_is_selected(const struct bm_menu *menu, const struct bm_item *item);
+bool ptrmap_put(struct ptrmap *map, const void *key, uint32_t value);
+bool ptrmap_get(const struct ptrmap *map, const void *key, uint32_t *out_value);
+bool ptrmap_remove(struct ptrmap *map, const void *key);
+void ptrmap_release(struct ptrmap *map);
 
 #endif /* _BEMENU_INTERNAL_H_ */
 
@@ -3,14 +3,66 @@
 #include <assert.h>
 #include <string.h>
 
+/**
+ * Count of text changes of items, see item_text_revision.
+ */
+static uint32_t text_revision;
+
+static char*
+inline_text(struct bm_item *item)
+{
+    return (char*)(item + 1);
+}
+
+/**
+ * Changes whenever the text of an existing item changes, through any item.
+ * Lets caches of item texts skip checking their items while nothing has changed.
+ */
+uint32_t
+item_text_revision(void)
+{
+    return __atomic_load_n(&text_revision, __ATOMIC_ACQUIRE);
+}
+
+static bool
+set_text(struct bm_item *item, const char *text)
+{
+    const size_t len = (text ? strlen(text) : 0);
+
+    char *copy = NULL;
+    if (text && len < item->inline_size) {
+        /* empty text can not be copied, like with bm_strdup */
+        if (len == 0)
+            return false;
+
+        /* text may be the current inline text */
+        copy = memmove(inline_text(item), text, len + 1);
+    } else if (text && !(copy = bm_strdup(text))) {
+        return false;
+    }
+
+    if (!(item->flags & (BM_ITEM_TEXT_BORROWED | BM_ITEM_TEXT_CODED | BM_ITEM_TEXT_INLINE)))
+        free(item->text);
+
+    item->text = copy;
+    item->flags &= ~(BM_ITEM_TEXT_BORROWED | BM_ITEM_TEXT_CODED | BM_ITEM_TEXT_INLINE | BM_ITEM_FIELDS);
+    item->flags |= (copy && copy == inline_text(item) ? BM_ITEM_TEXT_INLINE : 0);
+    return true;
+}
+
 struct bm_item*
 bm_item_new(const char *text)
 {
+    /* short texts live in the same allocation as the item, the storage is kept for later bm_item_set_text */
+    const size_t inline_size = (!text || strlen(text) < BM_ITEM_INLINE_TEXT ? BM_ITEM_INLINE_TEXT : 0);
+
     struct bm_item *item;
-    if (!(item = calloc(1, sizeof(struct bm_item))))
+    if (!(item = calloc(1, sizeof(struct bm_item) + inline_size)))
         return NULL;
 
-    bm_item_set_text(item, text);
+    /* a new item is in no cache yet, so this is not a change of text */
+    item->inline_size = inline_size;
+    set_text(item, text);
     return item;
 }
 
@@ -18,8 +70,13 @@ void
 bm_item_free(struct bm_item *item)
 {
     assert(item);
-    free(item->text);
-    free(item);
+
+    if (!(item->flags & (BM_ITEM_TEXT_BORROWED | BM_ITEM_TEXT_CODED | BM_ITEM_TEXT_INLINE)))
+        free(item->text);
+
+    /* arena items are released with the menu's arena */
+    if (!(item->flags & BM_ITEM_ARENA))
+        free(item);
 }
 
 void
@@ -41,12 +98,11 @@ bm_item_set_text(struct bm_item *item, const char *text)
 {
     assert(item);
 
-    char *copy = NULL;
-    if (text && !(copy = bm_strdup(text)))
+    if (!set_text(item, text))
         return false;
 
-    free(item->text);
-    item->text = copy;
+    item->revision++;
+    __atomic_add_fetch(&text_revision, 1, __ATOMIC_RELEASE);
     return true;
 }
 
@@ -54,7 +110,24 @@ const char*
 bm_item_get_text(const struct bm_item *item)
 {
     assert(item);
+
+    if (item->flags & BM_ITEM_TEXT_CODED)
+        return fcstore_text(item);
+
     return item->text;
 }
 
+const char*
+bm_item_get_field(const struct bm_item *item, uint32_t field)
+{
+    assert(item);
+
+    if (!(item->flags & BM_ITEM_FIELDS))
+        return (field == 0 ? bm_item_get_text(item) : NULL);
+
+    /* field count followed by offset of each field from text */
+    const uint32_t *table = (const uint32_t*)(item + 1);
+    return (field < table[0] ? item->text + table[1 + field] : NULL);
+}
+
 /* vim: set ts=8 sw=4 tw=0 :*/
@@ -10,6 +10,7 @@
 #include <assert.h>
 
 static struct list renderers;
+static struct list filter_engines;
 
 static void
 bm_renderer_free(struct bm_renderer *renderer)
@@ -121,6 +122,102 @@ fail:
     return false;
 }
 
+static void
+bm_filter_engine_free(struct bm_filter_engine *engine)
+{
+    assert(engine);
+
+    if (engine->handle)
+        chckDlUnload(engine->handle);
+
+    free(engine->name);
+    free(engine->file);
+    free(engine);
+}
+
+static bool
+load_filter_engine(const char *file, struct bm_filter_engine *engine)
+{
+    void *handle;
+    const char *error = NULL;
+
+    if (!(handle = chckDlLoad(file, &error)))
+        goto load_fail;
+
+    union {
+        const char* (*fun)(struct filter_api*);
+        void *ptr;
+    } reg;
+
+    if (!(reg.ptr = chckDlLoadSymbol(handle, "register_filter", &error)))
+        goto load_fail;
+
+    const char *name;
+    if (!(name = reg.fun(&engine->api)))
+        goto fail;
+
+    if (!engine->api.version || strcmp(engine->api.version, BM_PLUGIN_VERSION))
+        goto mismatch_fail;
+
+    if (!engine->api.filter)
+        goto fail;
+
+    if (!engine->name)
+        engine->name = bm_strdup(name);
+
+    if (!engine->file)
+        engine->file = bm_strdup(file);
+
+    engine->handle = handle;
+    return true;
+
+load_fail:
+    fprintf(stderr, "%s\n", error);
+    goto fail;
+mismatch_fail:
+    fprintf(stderr, "%s: version mismatch (%s != %s)\n", name, (engine->api.version ? engine->api.version : "none"), BM_PLUGIN_VERSION);
+fail:
+    if (handle)
+        chckDlUnload(handle);
+    return false;
+}
+
+static bool
+load_filter_engine_to_list(const char *file)
+{
+    struct bm_filter_engine *engine;
+    if (!(engine = calloc(1, sizeof(struct bm_filter_engine))))
+        goto fail;
+
+    if (!load_filter_engine(file, engine))
+        goto fail;
+
+    chckDlUnload(engine->handle);
+    engine->handle = NULL;
+
+    if (!list_add_item(&filter_engines, engine))
+        goto fail;
+
+    return true;
+
+fail:
+    if (engine)
+        bm_filter_engine_free(engine);
+    return false;
+}
+
+bool
+bm_filter_engine_activate(struct bm_filter_engine *engine)
+{
+    assert(engine);
+
+    /* engines are stateless, so one loaded instance is shared by every menu */
+    if (engine->handle)
+        return true;
+
+    return load_filter_engine(engine->file, engine);
+}
+
 bool
 bm_init(void)
 {
@@ -128,12 +225,12 @@ bm_init(void)
         return true;
 
     static const char *rpath = INSTALL_LIBDIR "/bemenu";
-    const char *path = secure_getenv("BEMENU_RENDERER");
+    const char *renderer = secure_getenv("BEMENU_RENDERER");
 
-    if (path)
-        return load_to_list(path);
+    if (renderer && !load_to_list(renderer))
+        return false;
 
-    path = secure_getenv("BEMENU_RENDERERS");
+    const char *path = secure_getenv("BEMENU_RENDERERS");
 
     if (!path || access(path, R_OK) == -1)
         path = rpath;
@@ -144,20 +241,29 @@ bm_init(void)
 
     struct dirent *file;
     while ((file = readdir(dir))) {
-        if (file->d_type != DT_DIR && !strncmp(file->d_name, "bemenu-renderer-", strlen("bemenu-renderer-"))) {
+        if (file->d_type == DT_DIR)
+            continue;
+
+        bool is_renderer = !strncmp(file->d_name, "bemenu-renderer-", strlen("bemenu-renderer-"));
+        bool is_filter_engine = !strncmp(file->d_name, "bemenu-filter-", strlen("bemenu-filter-"));
+
+        if ((is_renderer && !renderer) || is_filter_engine) {
             char *fpath;
             if ((fpath = bm_dprintf("%s/%s", path, file->d_name))) {
-                load_to_list(fpath);
+                if (is_renderer) {
+                    load_to_list(fpath);
+                } else {
+                    load_filter_engine_to_list(fpath);
+                }
                 free(fpath);
             }
         }
     }
 
     closedir(dir);
-    return (renderers.count > 0 ? true : false);
 
 fail:
-    return false;
+    return (renderers.count > 0 ? true : false);
 }
 
 const struct bm_renderer**
@@ -167,6 +273,13 @@ bm_get_renderers(uint32_t *out_nmemb)
     return list_get_items(&renderers, out_nmemb);
 }
 
+const struct bm_filter_engine**
+bm_get_filter_engines(uint32_t *out_nmemb)
+{
+    assert(out_nmemb);
+    return list_get_items(&filter_engines, out_nmemb);
+}
+
 const char*
 bm_version(void)
 {
@@ -187,4 +300,11 @@ bm_renderer_get_priorty(const struct bm_renderer *renderer)
     return renderer->api.priorty;
 }
 
+const char*
+bm_filter_engine_get_name(const struct bm_filter_engine *engine)
+{
+    assert(engine);
+    return engine->name;
+}
+
 /* vim: set ts=8 sw=4 tw=0 :*/
@@ -76,31 +76,53 @@ list_grow(struct list *list, uint32_t step)
 {
     assert(list);
 
-    void *tmp;
-    uint32_t nsize = sizeof(void*) * (list->allocated + step);
+    if (step > UINT32_MAX - list->allocated)
+        return false;
 
-    if (!(tmp = realloc(list->items, nsize)))
+    void *tmp;
+    if (!(tmp = realloc(list->items, sizeof(void*) * ((size_t)list->allocated + step))))
         return false;
 
     list->items = tmp;
     list->allocated += step;
-    memset(&list->items[list->count], 0, sizeof(void*) * (list->allocated - list->count));
     return true;
 }
 
+/**
+ * Make room for at least nmemb items in total, without over-allocating.
+ */
+bool
+list_reserve(struct list *list, uint32_t nmemb)
+{
+    assert(list);
+
+    if (list->allocated >= nmemb)
+        return true;
+
+    return list_grow(list, nmemb - list->allocated);
+}
+
 bool
 list_add_item_at(struct list *list, void *item, uint32_t index)
 {
     assert(list && item);
 
-    if ((!list->items || list->allocated <= list->count) && !list_grow(list, 32))
+    if (list->count < index)
         return false;
 
-    if (index + 1 != list->count) {
-        uint32_t i = index;
-        memmove(&list->items[i + 1], &list->items[i], sizeof(void*) * (list->count - i));
+    /* double the capacity, so appending n items does O(log n) reallocs */
+    if (list->allocated <= list->count) {
+        uint32_t step = (list->allocated < 32 ? 32 : list->allocated);
+        if (step > UINT32_MAX - list->allocated)
+            step = UINT32_MAX - list->allocated;
+
+        if (!step || !list_grow(list, step))
+            return false;
     }
 
+    if (index < list->count)
+        memmove(&list->items[index + 1], &list->items[index], sizeof(void*) * (list->count - index));
+
     list->items[index] = item;
     list->count++;
     return true;
@@ -122,7 +144,7 @@ list_remove_item_at(struct list *list, uint32_t index)
     if (!list->items || list->count <= i)
         return false;
 
-    memmove(&list->items[i], &list->items[i + 1], sizeof(void*) * (list->count - i));
+    memmove(&list->items[i], &list->items[i + 1], sizeof(void*) * (list->count - i - 1));
     list->count--;
     return true;
 }
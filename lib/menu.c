@@ -4,7 +4,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "vim.h"
 
@@ -46,50 +50,277 @@ static struct bm_item** (*filter_func[BM_FILTER_MODE_LAST])(struct bm_menu *menu
     bm_filter_dmenu_case_insensitive /* BM_FILTER_DMENU_CASE_INSENSITIVE */
 };
 
-struct bm_menu*
-bm_menu_new(const char *renderer)
+/**
+ * Number of candidates matched between latency budget checks.
+ */
+static const uint32_t filter_slice = 1024;
+
+static uint64_t
+monotonic_us(void)
 {
-    struct bm_menu *menu;
-    if (!(menu = calloc(1, sizeof(struct bm_menu))))
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Drop filtering that did not finish within the latency budget.
+ * Filtered items are left partial, the next bm_menu_filter call filters from scratch.
+ * Callers that are not about to filter again mark the pass for restart instead, see items_will_grow.
+ */
+static void
+filter_cancel_pending(struct bm_menu *menu)
+{
+    if (menu->pending.owned)
+        free(menu->pending.candidates);
+
+    free(menu->pending.filter);
+    memset(&menu->pending, 0, sizeof(menu->pending));
+}
+
+/**
+ * Must be called before items are appended to the items list.
+ */
+void
+items_will_grow(struct bm_menu *menu)
+{
+    bm_speculate_reset(menu);
+
+    /* the cancelled pass is reported pending until bm_menu_filter runs it again on the changed items */
+    const bool restart = (menu->pending.filter || menu->pending.restart);
+    filter_cancel_pending(menu);
+    menu->pending.restart = restart;
+    menu->positions.valid = false;
+}
+
+/**
+ * Must be called before the items or filtered lists are changed by anything else than filtering or appending.
+ */
+static void
+items_will_change(struct bm_menu *menu)
+{
+    items_will_grow(menu);
+    columns_invalidate(&menu->columns);
+    menu->unique.covered = UINT32_MAX;
+}
+
+/**
+ * Add item to selection, unless it is selected already.
+ */
+bool
+selection_add(struct bm_menu *menu, struct bm_item *item)
+{
+    assert(menu && item);
+
+    if (ptrmap_get(&menu->selected, item, NULL))
+        return true;
+
+    if (!ptrmap_put(&menu->selected, item, 0))
+        return false;
+
+    if (!list_add_item(&menu->selection, item)) {
+        ptrmap_remove(&menu->selected, item);
+        return false;
+    }
+
+    return true;
+}
+
+void
+selection_remove(struct bm_menu *menu, struct bm_item *item)
+{
+    assert(menu);
+
+    if (ptrmap_remove(&menu->selected, item))
+        list_remove_item(&menu->selection, item);
+}
+
+void
+selection_clear(struct bm_menu *menu)
+{
+    assert(menu);
+    list_free_list(&menu->selection);
+    ptrmap_release(&menu->selected);
+}
+
+const struct columns*
+bm_menu_columns(struct bm_menu *menu)
+{
+    assert(menu);
+
+    if (!columns_update(&menu->columns, (struct bm_item**)menu->items.items, menu->items.count))
         return NULL;
 
-    menu->dirty = true;
+    return &menu->columns;
+}
 
-    menu->key_binding = BM_KEY_BINDING_DEFAULT;
-    menu->vim_mode = 'i';
-    menu->vim_last_key = 0;
+/**
+ * Whether renderer may be used for the menu, either the requested one or a GUI renderer.
+ * BEMENU_BACKEND overrides the choice.
+ */
+static bool
+renderer_wanted(const struct bm_renderer *renderer, const char *requested)
+{
+    const char *name = secure_getenv("BEMENU_BACKEND");
+    name = (name && strlen(name) > 0 ? name : NULL);
+
+    if (!name && !requested && renderer->api.priorty != BM_PRIO_GUI)
+        return false;
+
+    if ((requested && strcmp(requested, renderer->name)) || (name && strcmp(name, renderer->name)))
+        return false;
+
+    if (renderer->api.priorty == BM_PRIO_TERMINAL) {
+        /**
+         * Some sanity checks that we are in terminal.
+         * These however are not reliable, thus we don't auto-detect terminal based renderers.
+         * These will be only used when explicitly requested.
+         *
+         * Launching terminal based menu instance at background is not a good idea.
+         */
+        const char *term = getenv("TERM");
+        if (!term || !strlen(term) || getppid() == 1)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Construct the renderer when the menu is first shown, so menus that are never shown
+ * do not connect to the display. Options set before are passed to the renderer.
+ */
+static bool
+renderer_construct(struct bm_menu *menu)
+{
+    if (menu->renderer)
+        return true;
+
+    if (menu->renderer_failed)
+        return false;
 
     uint32_t count;
     const struct bm_renderer **renderers = bm_get_renderers(&count);
 
-    const char *name = secure_getenv("BEMENU_BACKEND");
-    name = (name && strlen(name) > 0 ? name : NULL);
+    for (uint32_t i = 0; i < count && !menu->renderer; ++i) {
+        if (renderer_wanted(renderers[i], menu->requested_renderer))
+            bm_renderer_activate((struct bm_renderer*)renderers[i], menu);
+    }
 
-    for (uint32_t i = 0; i < count; ++i) {
-        if (!name && !renderer && renderers[i]->api.priorty != BM_PRIO_GUI)
-            continue;
+    if (!menu->renderer) {
+        menu->renderer_failed = true;
+        return false;
+    }
 
-        if ((renderer && strcmp(renderer, renderers[i]->name)) || (name && strcmp(name, renderers[i]->name)))
-            continue;
+    /* the renderer starts with the defaults the menu had before the options were set */
+    const struct render_api *api = &menu->renderer->api;
 
-        if (renderers[i]->api.priorty == BM_PRIO_TERMINAL) {
-            /**
-             * Some sanity checks that we are in terminal.
-             * These however are not reliable, thus we don't auto-detect terminal based renderers.
-             * These will be only used when explicitly requested.
-             *
-             * Launching terminal based menu instance at background is not a good idea.
-             */
-            const char *term = getenv("TERM");
-            if (!term || !strlen(term) || getppid() == 1)
-                continue;
-        }
+    if (menu->monitor && api->set_monitor)
+        api->set_monitor(menu, menu->monitor);
 
-        if (bm_renderer_activate((struct bm_renderer*)renderers[i], menu))
-            break;
+    if (menu->monitor_name && api->set_monitor_name)
+        api->set_monitor_name(menu, menu->monitor_name);
+
+    if (menu->overlap && api->set_overlap)
+        api->set_overlap(menu, menu->overlap);
+
+    if ((menu->hmargin_size || menu->width_factor) && api->set_width)
+        api->set_width(menu, menu->hmargin_size, menu->width_factor);
+
+    if (menu->align && api->set_align)
+        api->set_align(menu, menu->align);
+
+    if (menu->y_offset && api->set_y_offset)
+        api->set_y_offset(menu, menu->y_offset);
+
+    if (menu->grabbed && api->grab_keyboard)
+        api->grab_keyboard(menu, menu->grabbed);
+
+    return true;
+}
+
+static void*
+renderer_thread(void *arg)
+{
+    renderer_construct(arg);
+    return NULL;
+}
+
+/**
+ * Wait for the renderer started by bm_menu_start_renderer.
+ */
+static void
+renderer_wait(struct bm_menu *menu)
+{
+    if (!menu->renderer_starting)
+        return;
+
+    pthread_join(menu->renderer_thread, NULL);
+    menu->renderer_starting = false;
+}
+
+/**
+ * Whether the renderer is constructed, without constructing it.
+ */
+static bool
+renderer_ready(struct bm_menu *menu)
+{
+    renderer_wait(menu);
+    return (menu->renderer != NULL);
+}
+
+static bool
+renderer_activate(struct bm_menu *menu)
+{
+    renderer_wait(menu);
+    return renderer_construct(menu);
+}
+
+bool
+bm_menu_start_renderer(struct bm_menu *menu)
+{
+    assert(menu);
+
+    if (menu->renderer_starting || menu->renderer)
+        return true;
+
+    if (menu->renderer_failed)
+        return false;
+
+    /* without a thread it is constructed on first render as usual */
+    menu->renderer_starting = !pthread_create(&menu->renderer_thread, NULL, renderer_thread, menu);
+    return menu->renderer_starting;
+}
+
+struct bm_menu*
+bm_menu_new(const char *renderer)
+{
+    struct bm_menu *menu;
+    if (!(menu = calloc(1, sizeof(struct bm_menu))))
+        return NULL;
+
+    menu->dirty = true;
+    menu->filtered_count = UINT32_MAX;
+
+    /* without the pipe pushed items still arrive, only on the next input event */
+    if (pipe(menu->incoming.wake) == 0) {
+        for (uint32_t i = 0; i < 2; ++i) {
+            fcntl(menu->incoming.wake[i], F_SETFD, FD_CLOEXEC);
+            fcntl(menu->incoming.wake[i], F_SETFL, O_NONBLOCK);
+        }
+    } else {
+        menu->incoming.wake[0] = menu->incoming.wake[1] = -1;
     }
 
-    if (!menu->renderer)
+    menu->key_binding = BM_KEY_BINDING_DEFAULT;
+    menu->vim_mode = 'i';
+    menu->vim_last_key = 0;
+
+    if (renderer && !(menu->requested_renderer = bm_strdup(renderer)))
+        goto fail;
+
+    /* the renderer is constructed later, but there must be one to construct */
+    if (!bm_menu_get_renderer(menu))
         goto fail;
 
     if (!bm_menu_set_font(menu, NULL))
@@ -115,9 +346,13 @@ bm_menu_free(struct bm_menu *menu)
 {
     assert(menu);
 
-    if (menu->renderer && menu->renderer->api.destructor)
+    bm_speculate_free(menu);
+
+    if (renderer_ready(menu) && menu->renderer->api.destructor)
         menu->renderer->api.destructor(menu);
 
+    free(menu->requested_renderer);
+
     free(menu->title);
     free(menu->filter);
     free(menu->old_filter);
@@ -129,26 +364,84 @@ bm_menu_free(struct bm_menu *menu)
         free(menu->colors[i].hex);
 
     bm_menu_free_items(menu);
+    columns_release(&menu->columns);
+    textset_release(&menu->unique.set);
+
+    free(menu->fields.match);
+    free(menu->fields.display);
+    free(menu->fields.scratch);
+
+    /* the filter item belongs to the menu, not to its items */
+    if (menu->filter_item)
+        bm_item_free(menu->filter_item);
+
+    ptrmap_release(&menu->positions.map);
+
+    for (struct bm_batch *batch = menu->incoming.head, *next; batch; batch = next) {
+        next = batch->next;
+
+        for (uint32_t i = 0; i < batch->count && !batch->retract; ++i)
+            bm_item_free(batch->items[i]);
+
+        free(batch);
+    }
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (menu->incoming.wake[i] >= 0)
+            close(menu->incoming.wake[i]);
+    }
+
     free(menu);
 }
 
+static void
+release_buffer(char *data, size_t len, enum bm_buffer_ownership ownership)
+{
+    if (ownership == BM_BUFFER_FREE) {
+        free(data);
+    } else if (ownership == BM_BUFFER_MUNMAP && data) {
+        munmap(data, len);
+    }
+}
+
+static void
+buffer_free(struct bm_buffer *buffer)
+{
+    assert(buffer);
+    release_buffer(buffer->data, buffer->len, buffer->ownership);
+    free(buffer);
+}
+
 void
 bm_menu_free_items(struct bm_menu *menu)
 {
     assert(menu);
-    list_free_list(&menu->selection);
+    items_will_change(menu);
+    selection_clear(menu);
     list_free_list(&menu->filtered);
     list_free_items(&menu->items, (list_free_fun)bm_item_free);
-
-    if (menu->filter_item)
-        free(menu->filter_item);
+    list_free_items(&menu->buffers, (list_free_fun)buffer_free);
+    list_free_items(&menu->stores, (list_free_fun)fcstore_free);
+    arena_release(&menu->arena);
 }
 
 const struct bm_renderer*
 bm_menu_get_renderer(struct bm_menu *menu)
 {
     assert(menu);
-    return menu->renderer;
+
+    if (renderer_ready(menu))
+        return menu->renderer;
+
+    /* the renderer tried first, it is only constructed when the menu is shown */
+    uint32_t count;
+    const struct bm_renderer **renderers = bm_get_renderers(&count);
+    for (uint32_t i = 0; i < count && !menu->renderer_failed; ++i) {
+        if (renderer_wanted(renderers[i], menu->requested_renderer))
+            return renderers[i];
+    }
+
+    return NULL;
 }
 
 void
@@ -217,6 +510,42 @@ bm_menu_get_filter_mode(const struct bm_menu *menu)
     return menu->filter_mode;
 }
 
+bool
+bm_menu_set_filter_engine(struct bm_menu *menu, const char *name)
+{
+    assert(menu);
+
+    struct bm_filter_engine *engine = NULL;
+    if (name) {
+        uint32_t count;
+        const struct bm_filter_engine **engines = bm_get_filter_engines(&count);
+        for (uint32_t i = 0; i < count && !engine; ++i) {
+            if (!strcmp(name, engines[i]->name))
+                engine = (struct bm_filter_engine*)engines[i];
+        }
+
+        if (!engine || !bm_filter_engine_activate(engine))
+            return false;
+    }
+
+    if (engine == menu->filter_engine)
+        return true;
+
+    /* results of the previous filter are not valid for the new engine */
+    items_will_change(menu);
+    free(menu->old_filter);
+    menu->old_filter = NULL;
+    menu->filter_engine = engine;
+    return true;
+}
+
+const struct bm_filter_engine*
+bm_menu_get_filter_engine(const struct bm_menu *menu)
+{
+    assert(menu);
+    return menu->filter_engine;
+}
+
 void
 bm_menu_set_lines(struct bm_menu *menu, uint32_t lines)
 {
@@ -395,7 +724,7 @@ bm_menu_get_height(struct bm_menu *menu)
 
     uint32_t height = 0;
 
-    if (menu->renderer->api.get_height) {
+    if (renderer_activate(menu) && menu->renderer->api.get_height) {
         height = menu->renderer->api.get_height(menu);
     }
 
@@ -409,7 +738,7 @@ bm_menu_get_width(struct bm_menu *menu)
 
     uint32_t width = 0;
 
-    if (menu->renderer->api.get_width) {
+    if (renderer_activate(menu) && menu->renderer->api.get_width) {
         width = menu->renderer->api.get_width(menu);
     }
 
@@ -500,13 +829,14 @@ void
 bm_menu_set_align(struct bm_menu *menu, enum bm_align align)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if(menu->align == align)
         return;
 
     menu->align = align;
 
-    if (menu->renderer->api.set_align)
+    if (renderer_ready(menu) && menu->renderer->api.set_align)
         menu->renderer->api.set_align(menu, align);
 }
 
@@ -521,13 +851,14 @@ void
 bm_menu_set_y_offset(struct bm_menu *menu, int32_t y_offset)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if(menu->y_offset == y_offset)
         return;
 
     menu->y_offset = y_offset;
 
-    if (menu->renderer->api.set_y_offset)
+    if (renderer_ready(menu) && menu->renderer->api.set_y_offset)
         menu->renderer->api.set_y_offset(menu, y_offset);
 }
 
@@ -542,6 +873,7 @@ void
 bm_menu_set_width(struct bm_menu *menu, uint32_t margin, float factor)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if(menu->hmargin_size == margin && menu->width_factor == factor)
         return;
@@ -549,7 +881,7 @@ bm_menu_set_width(struct bm_menu *menu, uint32_t margin, float factor)
     menu->hmargin_size = margin;
     menu->width_factor = factor;
 
-    if(menu->renderer->api.set_width)
+    if (renderer_ready(menu) && menu->renderer->api.set_width)
         menu->renderer->api.set_width(menu, margin, factor);
 }
 
@@ -571,13 +903,14 @@ void
 bm_menu_set_monitor(struct bm_menu *menu, int32_t monitor)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if (menu->monitor == monitor)
         return;
 
     menu->monitor = monitor;
 
-    if (menu->renderer->api.set_monitor)
+    if (renderer_ready(menu) && menu->renderer->api.set_monitor)
         menu->renderer->api.set_monitor(menu, monitor);
 }
 
@@ -585,6 +918,7 @@ void
 bm_menu_set_monitor_name(struct bm_menu *menu, char *monitor_name)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if (!monitor_name)
         return;
@@ -594,7 +928,7 @@ bm_menu_set_monitor_name(struct bm_menu *menu, char *monitor_name)
 
     menu->monitor_name = bm_strdup(monitor_name);
 
-    if (menu->renderer->api.set_monitor_name)
+    if (renderer_ready(menu) && menu->renderer->api.set_monitor_name)
         menu->renderer->api.set_monitor_name(menu, monitor_name);
 }
 
@@ -609,13 +943,14 @@ void
 bm_menu_grab_keyboard(struct bm_menu *menu, bool grab)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if (menu->grabbed == grab)
         return;
 
     menu->grabbed = grab;
 
-    if (menu->renderer->api.grab_keyboard)
+    if (renderer_ready(menu) && menu->renderer->api.grab_keyboard)
         menu->renderer->api.grab_keyboard(menu, grab);
 }
 
@@ -629,13 +964,14 @@ void
 bm_menu_set_panel_overlap(struct bm_menu *menu, bool overlap)
 {
     assert(menu);
+    renderer_wait(menu);
 
     if (menu->overlap == overlap)
         return;
 
     menu->overlap = overlap;
 
-    if (menu->renderer->api.set_overlap)
+    if (renderer_ready(menu) && menu->renderer->api.set_overlap)
         menu->renderer->api.set_overlap(menu, overlap);
 }
 
@@ -668,16 +1004,90 @@ bm_menu_get_password(struct bm_menu *menu)
     return menu->password;
 }
 
+struct bm_item*
+bm_menu_new_item(struct bm_menu *menu, const char *text)
+{
+    assert(menu);
+
+    const size_t len = (text ? strlen(text) : 0);
+
+    /* text follows the item, so both share a cache line */
+    struct bm_item *item;
+    if (!(item = arena_alloc(&menu->arena, sizeof(struct bm_item) + (text ? len + 1 : 0), sizeof(void*))))
+        return NULL;
+
+    memset(item, 0, sizeof(struct bm_item));
+    item->flags = BM_ITEM_ARENA | BM_ITEM_TEXT_BORROWED;
+
+    if (text) {
+        item->text = (char*)(item + 1);
+        memcpy(item->text, text, len + 1);
+    }
+
+    return item;
+}
+
 bool
 bm_menu_add_item_at(struct bm_menu *menu, struct bm_item *item, uint32_t index)
 {
     assert(menu);
+    items_will_change(menu);
     return list_add_item_at(&menu->items, item, index);
 }
 
+bool
+bm_menu_reserve_items(struct bm_menu *menu, uint32_t nmemb)
+{
+    assert(menu);
+
+    if (menu->items.allocated >= nmemb)
+        return true;
+
+    items_will_grow(menu);
+    return list_reserve(&menu->items, nmemb);
+}
+
+bool
+bm_menu_add_items_front_coded(struct bm_menu *menu, const char **texts, uint32_t nmemb)
+{
+    assert(menu && texts);
+
+    if (nmemb > UINT32_MAX - menu->items.count)
+        return false;
+
+    struct fcstore *store;
+    if (!(store = fcstore_new(texts, nmemb)))
+        return false;
+
+    if (!list_add_item(&menu->stores, store)) {
+        fcstore_free(store);
+        return false;
+    }
+
+    struct bm_item *items;
+    if (nmemb && !(items = arena_alloc(&menu->arena, sizeof(struct bm_item) * nmemb, sizeof(void*))))
+        return false;
+
+    if (!bm_menu_reserve_items(menu, menu->items.count + nmemb))
+        return false;
+
+    items_will_grow(menu);
+
+    for (uint32_t i = 0; i < nmemb; ++i) {
+        memset(&items[i], 0, sizeof(struct bm_item));
+        items[i].flags = BM_ITEM_ARENA;
+        fcstore_bind(store, &items[i], i);
+        menu->items.items[menu->items.count++] = &items[i];
+    }
+
+    return true;
+}
+
 bool
 bm_menu_add_item(struct bm_menu *menu, struct bm_item *item)
 {
+    assert(menu);
+    items_will_grow(menu);
     return list_add_item(&menu->items, item);
 }
 
@@ -689,11 +1099,13 @@ bm_menu_remove_item_at(struct bm_menu *menu, uint32_t index)
     if (!menu->items.items || menu->items.count <= index)
         return 0;
 
+    items_will_change(menu);
+
     struct bm_item *item = ((struct bm_item**)menu->items.items)[index];
     bool ret = list_remove_item_at(&menu->items, index);
 
     if (ret) {
-        list_remove_item(&menu->selection, item);
+        selection_remove(menu, item);
         list_remove_item(&menu->filtered, item);
     }
 
@@ -704,30 +1116,284 @@ bool
 bm_menu_remove_item(struct bm_menu *menu, struct bm_item *item)
 {
     assert(menu);
+    items_will_change(menu);
 
     bool ret = list_remove_item(&menu->items, item);
 
     if (ret) {
-        list_remove_item(&menu->selection, item);
+        selection_remove(menu, item);
         list_remove_item(&menu->filtered, item);
     }
 
     return ret;
 }
 
-bool
-bm_menu_set_highlighted_index(struct bm_menu *menu, uint32_t index)
+/**
+ * Drop items found in removed from list, keeping the order of the rest.
+ */
+static void
+list_compact(struct list *list, const struct ptrmap *removed)
 {
-    assert(menu);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < list->count; ++i) {
+        if (!ptrmap_get(removed, list->items[i], NULL))
+            list->items[n++] = list->items[i];
+    }
 
-    uint32_t count;
-    bm_menu_get_filtered_items(menu, &count);
+    list->count = n;
+}
 
-    if (count <= index)
-        index = (count > 0 ? count - 1 : 0);
+int64_t
+bm_menu_remove_items(struct bm_menu *menu, bool (*predicate)(struct bm_item *item, uint32_t index, void *userdata), void *userdata)
+{
+    assert(menu && predicate);
 
-    if (menu->index != index)
-        menu->dirty = true;
+    /* speculation and pending filtering read the items, they must be done before predicate sees them */
+    items_will_change(menu);
+
+    struct ptrmap removed = {0};
+    struct bm_item **items = list_get_items(&menu->items, NULL);
+    for (uint32_t i = 0; i < menu->items.count; ++i) {
+        if (predicate(items[i], i, userdata) && !ptrmap_put(&removed, items[i], 0)) {
+            ptrmap_release(&removed);
+            return -1;
+        }
+    }
+
+    if (!removed.count)
+        return 0;
+
+    list_compact(&menu->items, &removed);
+    list_compact(&menu->filtered, &removed);
+
+    if (menu->selected.count) {
+        list_compact(&menu->selection, &removed);
+        for (uint32_t i = 0; i < removed.size; ++i) {
+            if (removed.keys[i])
+                ptrmap_remove(&menu->selected, removed.keys[i]);
+        }
+    }
+
+    const int64_t count = removed.count;
+    ptrmap_release(&removed);
+    return count;
+}
+
+/**
+ * Find position of item among the items returned by bm_menu_get_filtered_items.
+ * The reverse index is rebuilt when the filtered items have changed since the last lookup.
+ */
+static bool
+filtered_position(struct bm_menu *menu, struct bm_item *item, uint32_t *out_index)
+{
+    uint32_t count;
+    struct bm_item **items = bm_menu_get_filtered_items(menu, &count);
+
+    if (!menu->positions.valid || menu->positions.items != items || menu->positions.count != count) {
+        ptrmap_release(&menu->positions.map);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!ptrmap_put(&menu->positions.map, items[i], i))
+                goto linear;
+        }
+
+        menu->positions.items = items;
+        menu->positions.count = count;
+        menu->positions.valid = true;
+    }
+
+    /* items may have been reordered through bm_menu_get_items, so verify the hit */
+    if (!ptrmap_get(&menu->positions.map, item, out_index))
+        return false;
+
+    if (items[*out_index] == item)
+        return true;
+
+linear:
+    ptrmap_release(&menu->positions.map);
+    menu->positions.valid = false;
+
+    uint32_t i;
+    for (i = 0; i < count && items[i] != item; ++i);
+    *out_index = i;
+    return (i < count);
+}
+
+static bool
+incoming_queue(struct bm_menu *menu, struct bm_item **items, uint32_t nmemb, bool retract)
+{
+    assert(menu);
+
+    if (!items || !nmemb)
+        return true;
+
+    struct bm_batch *batch;
+    if (!(batch = malloc(sizeof(struct bm_batch) + sizeof(struct bm_item*) * nmemb)))
+        return false;
+
+    batch->retract = retract;
+    batch->count = nmemb;
+    memcpy(batch->items, items, sizeof(struct bm_item*) * nmemb);
+
+    batch->next = __atomic_load_n(&menu->incoming.head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&menu->incoming.head, &batch->next, batch, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    if (menu->incoming.wake[1] >= 0) {
+        const char byte = 0;
+        ssize_t ret = write(menu->incoming.wake[1], &byte, 1);
+        (void)ret;
+    }
+
+    return true;
+}
+
+bool
+bm_menu_push_items(struct bm_menu *menu, struct bm_item **items, uint32_t nmemb)
+{
+    return incoming_queue(menu, items, nmemb, false);
+}
+
+bool
+bm_menu_retract_items(struct bm_menu *menu, struct bm_item **items, uint32_t nmemb)
+{
+    return incoming_queue(menu, items, nmemb, true);
+}
+
+/**
+ * Append pushed items, matching only them against the current filter result.
+ */
+static void
+incoming_append(struct bm_menu *menu, struct bm_batch *batch)
+{
+    items_will_grow(menu);
+
+    if (!list_reserve(&menu->items, menu->items.count + batch->count)) {
+        for (uint32_t i = 0; i < batch->count; ++i)
+            bm_item_free(batch->items[i]);
+        return;
+    }
+
+    const uint32_t first = menu->items.count;
+    struct bm_item **added = (struct bm_item**)menu->items.items + first;
+    memcpy(added, batch->items, sizeof(struct bm_item*) * batch->count);
+    menu->items.count += batch->count;
+
+    if (menu->unique.enabled)
+        unique_tail(menu, first);
+
+    /* filtered items are the complete result of old_filter, if there is one */
+    if (!menu->old_filter || !*menu->old_filter)
+        return;
+
+    /* engines see the whole item set, so let the next pass filter from scratch */
+    if (menu->filter_engine || !list_reserve(&menu->filtered, menu->filtered.count + batch->count)) {
+        free(menu->old_filter);
+        menu->old_filter = NULL;
+        menu->pending.restart = true;
+        return;
+    }
+
+    struct bm_item **matches = (struct bm_item**)menu->filtered.items + menu->filtered.count;
+    uint32_t count = bm_filter_match(menu->filter_mode, &menu->fields, menu->old_filter, added, menu->items.count - first, NULL, matches);
+    bm_filter_rank(menu->filter_mode, &menu->fields, menu->old_filter, matches, count);
+    menu->filtered.count += count;
+}
+
+/**
+ * Match items of the retracted set, marking them found.
+ * Replacing the value of a key in the set never fails.
+ */
+static bool
+retracted(struct bm_item *item, uint32_t index, void *userdata)
+{
+    (void)index;
+
+    if (!ptrmap_get(userdata, item, NULL))
+        return false;
+
+    ptrmap_put(userdata, item, 1);
+    return true;
+}
+
+static void
+incoming_retract(struct bm_menu *menu, struct bm_batch *batch)
+{
+    struct ptrmap set = {0};
+    for (uint32_t i = 0; i < batch->count; ++i) {
+        if (!ptrmap_put(&set, batch->items[i], 0))
+            goto out;
+    }
+
+    /* items are freed only once they are out of every list, after running out of memory they stay in the menu */
+    if (bm_menu_remove_items(menu, retracted, &set) <= 0)
+        goto out;
+
+    for (uint32_t i = 0; i < set.size; ++i) {
+        if (set.keys[i] && set.values[i])
+            bm_item_free((struct bm_item*)set.keys[i]);
+    }
+
+out:
+    ptrmap_release(&set);
+}
+
+/**
+ * Apply items pushed and retracted by producer threads, in the order they were queued.
+ * Highlight stays on the same item, if it is still there.
+ */
+static void
+incoming_drain(struct bm_menu *menu)
+{
+    if (menu->incoming.wake[0] >= 0) {
+        char buf[64];
+        while (read(menu->incoming.wake[0], buf, sizeof(buf)) > 0);
+    }
+
+    struct bm_batch *batch;
+    if (!(batch = __atomic_exchange_n(&menu->incoming.head, NULL, __ATOMIC_ACQUIRE)))
+        return;
+
+    /* the queue is a stack, reverse it to get the batches in order */
+    struct bm_batch *ordered = NULL;
+    for (struct bm_batch *next; batch; batch = next) {
+        next = batch->next;
+        batch->next = ordered;
+        ordered = batch;
+    }
+
+    struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
+
+    for (struct bm_batch *next; ordered; ordered = next) {
+        next = ordered->next;
+
+        if (ordered->retract) {
+            incoming_retract(menu, ordered);
+        } else {
+            incoming_append(menu, ordered);
+        }
+
+        free(ordered);
+    }
+
+    if (!highlighted || !bm_menu_set_highlighted_item(menu, highlighted))
+        bm_menu_set_highlighted_index(menu, menu->index);
+
+    menu->dirty = true;
+}
+
+bool
+bm_menu_set_highlighted_index(struct bm_menu *menu, uint32_t index)
+{
+    assert(menu);
+
+    uint32_t count;
+    bm_menu_get_filtered_items(menu, &count);
+
+    if (count <= index)
+        index = (count > 0 ? count - 1 : 0);
+
+    if (menu->index != index)
+        menu->dirty = true;
 
     return (menu->index = index);
 }
@@ -737,14 +1403,11 @@ bm_menu_set_highlighted_item(struct bm_menu *menu, struct bm_item *item)
 {
     assert(menu);
 
-    uint32_t i, count;
-    struct bm_item **items = bm_menu_get_filtered_items(menu, &count);
-    for (i = 0; i < count && items[i] != item; ++i);
-
-    if (count <= i)
+    uint32_t index;
+    if (!filtered_position(menu, item, &index))
         return 0;
 
-    return (bm_menu_set_highlighted_index(menu, i));
+    return (bm_menu_set_highlighted_index(menu, index));
 }
 
 struct bm_item*
@@ -766,12 +1429,115 @@ bm_menu_set_selected_items(struct bm_menu *menu, struct bm_item **items, uint32_
 {
     assert(menu);
 
-    struct bm_item **new_items;
-    if (!(new_items = calloc(nmemb, sizeof(struct bm_item*))))
-        return 0;
+    selection_clear(menu);
+
+    for (uint32_t i = 0; i < nmemb; ++i) {
+        if (!selection_add(menu, items[i]))
+            return false;
+    }
+
+    return true;
+}
+
+bool
+bm_menu_select_filtered_items(struct bm_menu *menu)
+{
+    assert(menu);
+
+    uint32_t count;
+    struct bm_item **items = bm_menu_get_filtered_items(menu, &count);
+
+    if (!list_reserve(&menu->selection, menu->selection.count + count))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ptrmap_get(&menu->selected, items[i], NULL))
+            continue;
+
+        if (!ptrmap_put(&menu->selected, items[i], 0))
+            return false;
+
+        menu->selection.items[menu->selection.count++] = items[i];
+    }
 
-    memcpy(new_items, items, sizeof(struct bm_item*) * nmemb);
-    return list_set_items_no_copy(&menu->selection, new_items, nmemb);
+    return true;
+}
+
+bool
+bm_menu_invert_selection(struct bm_menu *menu)
+{
+    assert(menu);
+
+    uint32_t count;
+    struct bm_item **items = bm_menu_get_filtered_items(menu, &count);
+
+    /* mark the filtered items that are selected, those get unselected */
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ptrmap_get(&menu->selected, items[i], NULL))
+            ptrmap_put(&menu->selected, items[i], 1);
+    }
+
+    struct list selection = {0};
+    struct ptrmap selected = {0};
+    if (!list_reserve(&selection, menu->selection.count + count))
+        goto fail;
+
+    struct bm_item **old = list_get_items(&menu->selection, NULL);
+    for (uint32_t i = 0; i < menu->selection.count; ++i) {
+        uint32_t mark;
+        if (ptrmap_get(&menu->selected, old[i], &mark) && mark)
+            continue;
+
+        if (!ptrmap_put(&selected, old[i], 0))
+            goto fail;
+
+        selection.items[selection.count++] = old[i];
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ptrmap_get(&menu->selected, items[i], NULL) || ptrmap_get(&selected, items[i], NULL))
+            continue;
+
+        if (!ptrmap_put(&selected, items[i], 0))
+            goto fail;
+
+        selection.items[selection.count++] = items[i];
+    }
+
+    selection_clear(menu);
+    menu->selection = selection;
+    menu->selected = selected;
+    return true;
+
+fail:
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ptrmap_get(&menu->selected, items[i], NULL))
+            ptrmap_put(&menu->selected, items[i], 0);
+    }
+    list_free_list(&selection);
+    ptrmap_release(&selected);
+    return false;
+}
+
+void
+bm_menu_clear_selection(struct bm_menu *menu)
+{
+    assert(menu);
+    selection_clear(menu);
+}
+
+void
+bm_menu_set_latency_budget(struct bm_menu *menu, uint32_t budget)
+{
+    assert(menu);
+    menu->latency_budget = budget;
+}
+
+uint32_t
+bm_menu_get_latency_budget(const struct bm_menu *menu)
+{
+    assert(menu);
+    return menu->latency_budget;
 }
 
 void
@@ -790,17 +1556,247 @@ bool
 bm_menu_set_items(struct bm_menu *menu, const struct bm_item **items, uint32_t nmemb)
 {
     assert(menu);
+    items_will_change(menu);
 
     bool ret = list_set_items(&menu->items, items, nmemb, (list_free_fun)bm_item_free);
 
     if (ret) {
-        list_free_list(&menu->selection);
+        selection_clear(menu);
         list_free_list(&menu->filtered);
     }
 
     return ret;
 }
 
+/**
+ * Create item for a line split into fields in place.
+ * Field count and offsets are allocated after the item, fields are null terminated.
+ */
+static struct bm_item*
+new_fields_item(struct bm_menu *menu, char *line, size_t len, char separator)
+{
+    /* offsets are 32 bit, longer lines are kept whole */
+    uint32_t count = 1;
+    for (const char *s = line, *end = line + len; len <= UINT32_MAX && (s = memchr(s, separator, end - s)); ++s)
+        ++count;
+
+    struct bm_item *item;
+    if (!(item = arena_alloc(&menu->arena, sizeof(struct bm_item) + sizeof(uint32_t) * (1 + count), sizeof(void*))))
+        return NULL;
+
+    *item = (struct bm_item){ .text = line, .flags = BM_ITEM_ARENA | BM_ITEM_TEXT_BORROWED | BM_ITEM_FIELDS };
+
+    uint32_t *table = (uint32_t*)(item + 1);
+    table[0] = count;
+    table[1] = 0;
+
+    for (uint32_t i = 1; i < count; ++i) {
+        char *s = memchr(line + table[i], separator, len - table[i]);
+        *s = 0;
+        table[1 + i] = (uint32_t)(s + 1 - line);
+    }
+
+    return item;
+}
+
+/**
+ * Append items that point into the buffer.
+ * The buffer is owned by the menu after this, even on failure.
+ */
+static bool
+add_items_from_buffer(struct bm_menu *menu, char *buffer, size_t len, char delimiter, enum bm_buffer_ownership ownership)
+{
+    struct bm_buffer *owned;
+    if (!(owned = calloc(1, sizeof(struct bm_buffer))))
+        goto fail;
+
+    *owned = (struct bm_buffer){ .data = buffer, .len = len, .ownership = ownership };
+
+    if (!list_add_item(&menu->buffers, owned)) {
+        free(owned);
+        goto fail;
+    }
+
+    /* items split into fields differ in size, so they are allocated one by one */
+    const char separator = menu->fields.separator;
+
+    /* large buffers are split between cores up to the last delimiter, the rest is added below */
+    if (!separator) {
+        size_t split = len;
+        for (; split > 0 && buffer[split - 1] != delimiter; --split);
+
+        if (ingest_lines(menu, buffer, split, delimiter)) {
+            buffer += split;
+            len -= split;
+        }
+    }
+
+    uint32_t count = 0;
+    for (char *s = buffer, *end = buffer + len, *d; s < end; s = d + 1, ++count) {
+        if (!(d = memchr(s, delimiter, end - s)))
+            d = end;
+    }
+
+    if (!count)
+        return true;
+
+    struct bm_item *items = NULL;
+    if (!separator && !(items = arena_alloc(&menu->arena, sizeof(struct bm_item) * count, sizeof(void*))))
+        return false;
+
+    items_will_grow(menu);
+
+    if (!list_reserve(&menu->items, menu->items.count + count))
+        return false;
+
+    uint32_t i = 0;
+    for (char *s = buffer, *end = buffer + len, *d; s < end; s = d + 1, ++i) {
+        char *text = s;
+        if ((d = memchr(s, delimiter, end - s))) {
+            *d = 0;
+        } else {
+            /* last item has no room for a terminator in the buffer */
+            d = end;
+            if (!(text = arena_alloc(&menu->arena, end - s + 1, 1)))
+                break;
+
+            memcpy(text, s, end - s);
+            text[end - s] = 0;
+        }
+
+        struct bm_item *item;
+        if (separator) {
+            if (!(item = new_fields_item(menu, text, d - s, separator)))
+                break;
+        } else {
+            item = &items[i];
+            *item = (struct bm_item){ .text = text, .flags = BM_ITEM_ARENA | BM_ITEM_TEXT_BORROWED };
+        }
+
+        menu->items.items[menu->items.count++] = item;
+    }
+
+    return (i == count);
+
+fail:
+    release_buffer(buffer, len, ownership);
+    return false;
+}
+
+bool
+bm_menu_set_fields(struct bm_menu *menu, char separator, const uint32_t *match, uint32_t nmatch, const uint32_t *display, uint32_t ndisplay)
+{
+    assert(menu && (match || !nmatch) && (display || !ndisplay));
+
+    uint32_t *match_copy = NULL, *display_copy = NULL;
+    if ((nmatch && !(match_copy = calloc(nmatch, sizeof(uint32_t)))) || (ndisplay && !(display_copy = calloc(ndisplay, sizeof(uint32_t))))) {
+        free(match_copy);
+        return false;
+    }
+
+    if (nmatch)
+        memcpy(match_copy, match, sizeof(uint32_t) * nmatch);
+
+    if (ndisplay)
+        memcpy(display_copy, display, sizeof(uint32_t) * ndisplay);
+
+    /* results of the old layout can not be refined, and speculation reads the layout */
+    items_will_grow(menu);
+    free(menu->old_filter);
+    menu->old_filter = NULL;
+
+    free(menu->fields.match);
+    free(menu->fields.display);
+    menu->fields.separator = separator;
+    menu->fields.match = match_copy;
+    menu->fields.nmatch = nmatch;
+    menu->fields.display = display_copy;
+    menu->fields.ndisplay = ndisplay;
+    return true;
+}
+
+const char*
+bm_menu_get_item_display_text(struct bm_menu *menu, const struct bm_item *item)
+{
+    assert(menu && item);
+
+    if (!(item->flags & BM_ITEM_FIELDS))
+        return bm_item_get_text(item);
+
+    struct fields *fields = &menu->fields;
+    const uint32_t count = (fields->ndisplay ? fields->ndisplay : UINT32_MAX);
+
+    size_t len = 0;
+    const char *field;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!(field = bm_item_get_field(item, (fields->ndisplay ? fields->display[i] : i)))) {
+            if (!fields->ndisplay)
+                break;
+
+            continue;
+        }
+
+        len += strlen(field) + 1;
+    }
+
+    if (fields->scratch_size < len + 1) {
+        void *tmp;
+        if (!(tmp = realloc(fields->scratch, len + 1)))
+            return NULL;
+
+        fields->scratch = tmp;
+        fields->scratch_size = len + 1;
+    }
+
+    /* fields are joined with the separator they were split on */
+    char *out = fields->scratch;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!(field = bm_item_get_field(item, (fields->ndisplay ? fields->display[i] : i)))) {
+            if (!fields->ndisplay)
+                break;
+
+            continue;
+        }
+
+        if (out != fields->scratch)
+            *out++ = (fields->separator ? fields->separator : ' ');
+
+        const size_t flen = strlen(field);
+        memcpy(out, field, flen);
+        out += flen;
+    }
+
+    *out = 0;
+    return fields->scratch;
+}
+
+bool
+bm_menu_set_items_from_buffer(struct bm_menu *menu, char *buffer, size_t len, char delimiter, enum bm_buffer_ownership ownership)
+{
+    assert(menu && (buffer || !len));
+    bm_menu_free_items(menu);
+    const bool ret = add_items_from_buffer(menu, buffer, len, delimiter, ownership);
+
+    if (menu->unique.enabled)
+        unique_tail(menu, 0);
+
+    return ret;
+}
+
+void
+bm_menu_set_unique(struct bm_menu *menu, bool unique)
+{
+    assert(menu);
+    menu->unique.enabled = unique;
+}
+
+bool
+bm_menu_get_unique(const struct bm_menu *menu)
+{
+    assert(menu);
+    return menu->unique.enabled;
+}
+
 struct bm_item**
 bm_menu_get_items(const struct bm_menu *menu, uint32_t *out_nmemb)
 {
@@ -824,30 +1820,198 @@ bm_menu_render(struct bm_menu *menu)
 {
     assert(menu);
 
+    if (!renderer_activate(menu))
+        return false;
+
     if (menu->renderer->api.render)
         return menu->renderer->api.render(menu);
 
     return true;
 }
 
+/**
+ * Match next slice of pending candidates until half of the latency budget is spent.
+ * The other half is left for rendering the partial result.
+ * Once all candidates are matched, the result is ranked and filtering is complete.
+ */
+static void
+filter_continue_pending(struct bm_menu *menu)
+{
+    const uint64_t deadline = monotonic_us() + (uint64_t)menu->latency_budget * 1000 / 2;
+    const uint32_t old_count = menu->filtered.count;
+    struct bm_item **matches = (struct bm_item**)menu->filtered.items;
+
+    /* item texts may have changed between slices, rows are rechecked when they did */
+    if (menu->pending.columns)
+        menu->pending.columns = bm_menu_columns(menu);
+
+    do {
+        uint32_t n = (menu->pending.count - menu->pending.next < filter_slice ? menu->pending.count - menu->pending.next : filter_slice);
+        const struct columns slice = (menu->pending.columns ? columns_slice(menu->pending.columns, menu->pending.next) : (struct columns){0});
+        menu->filtered.count += bm_filter_match(menu->filter_mode, &menu->fields, menu->pending.filter, menu->pending.candidates + menu->pending.next, n, (menu->pending.columns ? &slice : NULL), matches + menu->filtered.count);
+        menu->pending.next += n;
+    } while (menu->pending.next < menu->pending.count && monotonic_us() < deadline);
+
+    if (menu->filtered.count != old_count)
+        menu->dirty = true;
+
+    if (menu->pending.next < menu->pending.count)
+        return;
+
+    bm_filter_rank(menu->filter_mode, &menu->fields, menu->pending.filter, matches, menu->filtered.count);
+    menu->dirty = true;
+    menu->positions.valid = false;
+    menu->filtered_count = menu->filtered.count;
+
+    free(menu->old_filter);
+    menu->old_filter = menu->pending.filter;
+    menu->pending.filter = NULL;
+    filter_cancel_pending(menu);
+
+    bm_speculate_start(menu, menu->filter, matches, menu->filtered.count, NULL);
+}
+
+/**
+ * Start filtering in slices that fit in the latency budget.
+ */
+static void
+filter_start_pending(struct bm_menu *menu, bool addition)
+{
+    uint32_t count;
+    struct bm_item **candidates = (addition ? list_get_items(&menu->filtered, &count) : list_get_items(&menu->items, &count));
+
+    char *filter;
+    struct bm_item **matches;
+    if (!(matches = calloc((count > 0 ? count : 1), sizeof(struct bm_item*))))
+        return;
+
+    if (!(filter = bm_strdup(menu->filter))) {
+        free(matches);
+        return;
+    }
+
+    bm_speculate_reset(menu);
+
+    if (addition) {
+        /* previous result is the candidates, it is freed once filtering completes */
+        memset(&menu->filtered, 0, sizeof(menu->filtered));
+    } else {
+        list_free_list(&menu->filtered);
+    }
+
+    menu->filtered.items = (void**)matches;
+    menu->filtered.allocated = count;
+    menu->pending.filter = filter;
+    menu->pending.candidates = candidates;
+    menu->pending.columns = (addition ? NULL : bm_menu_columns(menu));
+    menu->pending.count = count;
+    menu->pending.owned = addition;
+
+    free(menu->old_filter);
+    menu->old_filter = NULL;
+
+    bm_menu_set_highlighted_index(menu, 0);
+    filter_continue_pending(menu);
+}
+
+bool
+bm_menu_is_filter_pending(const struct bm_menu *menu)
+{
+    assert(menu);
+    return (menu->pending.filter || menu->pending.restart);
+}
+
+void
+bm_menu_get_memory_stats(const struct bm_menu *menu, struct bm_memory_stats *out_stats)
+{
+    assert(menu && out_stats);
+
+    struct bm_memory_stats stats = {0};
+
+    /* heap holds what is neither in the arena nor in a buffer */
+    size_t heap = 0;
+    struct fccursor cursor = {0};
+    struct bm_item **items = list_get_items(&menu->items, NULL);
+    for (uint32_t i = 0; i < menu->items.count; ++i) {
+        const char *text = fccursor_text(&cursor, items[i]);
+        const size_t len = (text ? strlen(text) + 1 : 0);
+        stats.items += sizeof(struct bm_item);
+        stats.text += len;
+        heap += (items[i]->flags & BM_ITEM_ARENA ? 0 : sizeof(struct bm_item) + items[i]->inline_size);
+        heap += (items[i]->flags & (BM_ITEM_TEXT_BORROWED | BM_ITEM_TEXT_CODED | BM_ITEM_TEXT_INLINE) ? 0 : len);
+    }
+
+    fccursor_release(&cursor);
+    stats.arena = menu->arena.size;
+
+    struct fcstore **stores = list_get_items(&menu->stores, NULL);
+    for (uint32_t i = 0; i < menu->stores.count; ++i)
+        stats.coded += fcstore_memory_usage(stores[i]);
+
+    struct bm_buffer **buffers = list_get_items(&menu->buffers, NULL);
+    for (uint32_t i = 0; i < menu->buffers.count; ++i)
+        stats.buffers += buffers[i]->len;
+
+    stats.lists = sizeof(void*) * ((size_t)menu->items.allocated + menu->filtered.allocated + menu->selection.allocated + menu->stores.allocated);
+
+    stats.caches += ((size_t)sizeof(struct bm_item*) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint64_t)) * menu->columns.allocated;
+    stats.caches += ((size_t)sizeof(void*) + sizeof(uint32_t)) * (menu->selected.size + menu->positions.map.size);
+    stats.caches += bm_speculate_memory_usage(menu);
+    stats.caches += menu->fields.scratch_size;
+    stats.caches += unique_memory_usage(menu);
+
+    /* a renderer still being constructed is not counted */
+    if (!menu->renderer_starting && menu->renderer && menu->renderer->api.get_memory_usage)
+        stats.renderer = menu->renderer->api.get_memory_usage(menu);
+
+    stats.total = heap + stats.arena + stats.buffers + stats.coded + stats.lists + stats.caches + stats.renderer;
+    *out_stats = stats;
+}
+
 void
 bm_menu_filter(struct bm_menu *menu)
 {
     assert(menu);
 
+    /* pushed items are part of the result, also before the menu runs */
+    if (__atomic_load_n(&menu->incoming.head, __ATOMIC_ACQUIRE))
+        incoming_drain(menu);
+
+    /* old_filter is unset whenever a restart is owed, so every path below filters again */
+    menu->pending.restart = false;
+
     char addition = 0;
     size_t len = (menu->filter ? strlen(menu->filter) : 0);
 
     if (!len || !menu->items.items || menu->items.count <= 0) {
-        list_free_list(&menu->filtered);
+        filter_cancel_pending(menu);
+
+        if (menu->filtered.items) {
+            bm_speculate_reset(menu);
+            list_free_list(&menu->filtered);
+            menu->positions.valid = false;
+        }
+
         free(menu->old_filter);
         menu->old_filter = NULL;
+        menu->filtered_count = menu->items.count;
+        bm_speculate_start(menu, "", (struct bm_item**)menu->items.items, menu->items.count, bm_menu_columns(menu));
         return;
     }
 
+    if (menu->pending.filter) {
+        if (!strcmp(menu->pending.filter, menu->filter)) {
+            filter_continue_pending(menu);
+            return;
+        }
+
+        filter_cancel_pending(menu);
+    }
+
     if (menu->old_filter) {
         size_t oldLen = strlen(menu->old_filter);
         addition = (oldLen < len && !memcmp(menu->old_filter, menu->filter, oldLen));
+        addition = (addition && (!menu->filter_engine || menu->filter_engine->api.incremental));
     }
     if (menu->old_filter && addition && menu->filtered.count <= 0)
         return;
@@ -856,13 +2020,30 @@ bm_menu_filter(struct bm_menu *menu)
         return;
 
     uint32_t count;
-    struct bm_item **filtered = filter_func[menu->filter_mode](menu, addition, &count);
+    struct bm_item **filtered;
+    if (!bm_speculate_take(menu, &filtered, &count)) {
+        /* speculation guessed wrong, stop it before it competes with the real pass */
+        bm_speculate_reset(menu);
+
+        if (menu->filter_engine) {
+            filtered = bm_filter_engine(menu, addition, &count);
+        } else if (menu->latency_budget > 0) {
+            filter_start_pending(menu, addition);
+            return;
+        } else {
+            filtered = filter_func[menu->filter_mode](menu, addition, &count);
+        }
+    }
 
+    bm_speculate_reset(menu);
     list_set_items_no_copy(&menu->filtered, filtered, count);
+    menu->positions.valid = false;
+    menu->filtered_count = count;
     bm_menu_set_highlighted_index(menu, 0);
 
     free(menu->old_filter);
     menu->old_filter = bm_strdup(menu->filter);
+    bm_speculate_start(menu, menu->filter, filtered, count, NULL);
 }
 
 enum bm_key
@@ -873,7 +2054,7 @@ bm_menu_poll_key(struct bm_menu *menu, uint32_t *out_unicode)
     *out_unicode = 0;
     enum bm_key key = BM_KEY_NONE;
 
-    if (menu->renderer->api.poll_key)
+    if (renderer_ready(menu) && menu->renderer->api.poll_key)
         key = menu->renderer->api.poll_key(menu, out_unicode);
 
     return key;
@@ -886,7 +2067,7 @@ bm_menu_poll_pointer(struct bm_menu *menu)
 
     struct bm_pointer pointer = {0};
 
-    if (menu->renderer->api.poll_pointer)
+    if (renderer_ready(menu) && menu->renderer->api.poll_pointer)
         pointer = menu->renderer->api.poll_pointer(menu);
 
     return pointer;
@@ -899,7 +2080,7 @@ bm_menu_poll_touch(struct bm_menu *menu)
 
     struct bm_touch touch = {0};
 
-    if (menu->renderer->api.poll_touch)
+    if (renderer_ready(menu) && menu->renderer->api.poll_touch)
         touch = menu->renderer->api.poll_touch(menu);
 
     return touch;
@@ -910,7 +2091,7 @@ bm_menu_release_touch(struct bm_menu *menu)
 {
     assert(menu);
 
-    if (menu->renderer->api.release_touch)
+    if (renderer_ready(menu) && menu->renderer->api.release_touch)
         menu->renderer->api.release_touch(menu);
 }
 
@@ -1022,11 +2203,13 @@ bm_menu_run_with_key(struct bm_menu *menu, enum bm_key key, uint32_t unicode)
 {
     assert(menu);
 
+    incoming_drain(menu);
+
     uint32_t count;
     bm_menu_get_filtered_items(menu, &count);
 
     uint32_t displayed = 0;
-    if (menu->renderer->api.get_displayed_count)
+    if (renderer_ready(menu) && menu->renderer->api.get_displayed_count)
         displayed = menu->renderer->api.get_displayed_count(menu);
 
     if (!displayed)
@@ -1042,7 +2225,7 @@ bm_menu_run_with_key(struct bm_menu *menu, enum bm_key key, uint32_t unicode)
             case BM_VIM_CONSUME:
                 return BM_RUN_RESULT_RUNNING;
             case BM_VIM_EXIT:
-                list_free_list(&menu->selection);
+                selection_clear(menu);
                 return BM_RUN_RESULT_CANCEL;
             case BM_VIM_IGNORE:
                 break;
@@ -1249,6 +2432,23 @@ bm_menu_run_with_key(struct bm_menu *menu, enum bm_key key, uint32_t unicode)
             }
             break;
 
+        case BM_KEY_SELECT_ALL:
+        case BM_KEY_INVERT_SELECTION:
+            /* act on the whole result, not only on what is matched so far */
+            while (bm_menu_is_filter_pending(menu))
+                bm_menu_filter(menu);
+
+            if (key == BM_KEY_SELECT_ALL) {
+                bm_menu_select_filtered_items(menu);
+            } else {
+                bm_menu_invert_selection(menu);
+            }
+            break;
+
+        case BM_KEY_CLEAR_SELECTION:
+            bm_menu_clear_selection(menu);
+            break;
+
         case BM_KEY_SHIFT_TAB:
             {
                 const char *text;
@@ -1272,14 +2472,14 @@ bm_menu_run_with_key(struct bm_menu *menu, enum bm_key key, uint32_t unicode)
         case BM_KEY_CUSTOM_10:
             {
                 struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
-                if (highlighted && !bm_menu_item_is_selected(menu, highlighted))
-                    list_add_item(&menu->selection, highlighted);
+                if (highlighted)
+                    selection_add(menu, highlighted);
             }
             break;
 
         case BM_KEY_SHIFT_RETURN: /* this will return the filter as selected item below! */
         case BM_KEY_ESCAPE: /* this will cancel however */
-            list_free_list(&menu->selection);
+            selection_clear(menu);
             break;
 
         default: break;
@@ -1302,7 +2502,7 @@ bm_menu_run_with_key(struct bm_menu *menu, enum bm_key key, uint32_t unicode)
         case BM_KEY_RETURN:
             if (!bm_menu_get_selected_items(menu, NULL)) {
                 bm_item_set_text(menu->filter_item, menu->filter);
-                list_add_item(&menu->selection, menu->filter_item);
+                selection_add(menu, menu->filter_item);
             }
             switch (key) {
                 case BM_KEY_CUSTOM_1: return BM_RUN_RESULT_CUSTOM_1;
@@ -1333,7 +2533,7 @@ bm_menu_run_with_pointer(struct bm_menu *menu, struct bm_pointer pointer)
     bm_menu_get_filtered_items(menu, &count);
 
     uint32_t displayed = 0;
-    if (menu->renderer->api.get_displayed_count)
+    if (renderer_ready(menu) && menu->renderer->api.get_displayed_count)
         displayed = menu->renderer->api.get_displayed_count(menu);
 
     if (!displayed)
@@ -1352,8 +2552,8 @@ bm_menu_run_with_pointer(struct bm_menu *menu, struct bm_pointer pointer)
                 case BM_POINTER_KEY_PRIMARY:
                     {
                         struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
-                        if (highlighted && !bm_menu_item_is_selected(menu, highlighted))
-                            list_add_item(&menu->selection, highlighted);
+                        if (highlighted)
+                            selection_add(menu, highlighted);
                     }
                     return BM_RUN_RESULT_SELECTED;
             }
@@ -1378,8 +2578,8 @@ bm_menu_run_with_pointer(struct bm_menu *menu, struct bm_pointer pointer)
             case BM_POINTER_KEY_PRIMARY:
                 {
                     struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
-                    if (highlighted && !bm_menu_item_is_selected(menu, highlighted))
-                        list_add_item(&menu->selection, highlighted);
+                    if (highlighted)
+                        selection_add(menu, highlighted);
                 }
                 return BM_RUN_RESULT_SELECTED;
         }
@@ -1395,7 +2595,7 @@ bm_menu_run_with_touch(struct bm_menu *menu, struct bm_touch touch)
     bm_menu_get_filtered_items(menu, &count);
 
     uint32_t displayed = 0;
-    if (menu->renderer->api.get_displayed_count)
+    if (renderer_ready(menu) && menu->renderer->api.get_displayed_count)
         displayed = menu->renderer->api.get_displayed_count(menu);
 
     if (!displayed)
@@ -1489,8 +2689,8 @@ bm_menu_run_with_touch(struct bm_menu *menu, struct bm_touch touch)
                 if (point.event_mask & TOUCH_EVENT_UP) {
                     {
                         struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
-                        if (highlighted && !bm_menu_item_is_selected(menu, highlighted))
-                            list_add_item(&menu->selection, highlighted);
+                        if (highlighted)
+                            selection_add(menu, highlighted);
                     }
                     return BM_RUN_RESULT_SELECTED;
                 }
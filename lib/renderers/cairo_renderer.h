@@ -224,8 +224,8 @@ bm_cairo_color_from_menu_color(const struct bm_menu *menu, enum bm_color color,
     c->a = (float)menu->colors[color].a / 255.0f;
 }
 
-static char *
-bm_cairo_entry_message(char *entry_text, bool highlighted, uint32_t event_feedback, uint32_t index, uint32_t count)
+static const char *
+bm_cairo_entry_message(const char *entry_text, bool highlighted, uint32_t event_feedback, uint32_t index, uint32_t count)
 {
     if (!highlighted || !event_feedback) {
         return entry_text ? entry_text : "";
@@ -307,8 +307,10 @@ bm_cairo_paint(struct cairo *cairo, uint32_t width, uint32_t max_height, struct
     double border_radius = menu->border_radius;
 
     uint32_t total_item_count = menu->items.count;
-    uint32_t filtered_item_count;
-    bm_menu_get_filtered_items(menu, &filtered_item_count);
+    /* counter keeps showing the last complete result until filtering has caught up */
+    uint32_t filtered_item_count = menu->filtered_count;
+    if (!bm_menu_is_filter_pending(menu))
+        bm_menu_get_filtered_items(menu, &filtered_item_count);
 
     cairo_save(cairo->cr);
     cairo_set_operator(cairo->cr, CAIRO_OPERATOR_CLEAR);
@@ -447,9 +449,9 @@ bm_cairo_paint(struct cairo *cairo, uint32_t width, uint32_t max_height, struct
                 bm_cairo_color_from_menu_color(menu, BM_COLOR_ITEM_BG, &paint.bg);
             }
 
-            char *line_str = "";
+            const char *line_str = "";
             if ((i < count && !is_fixed_up) || (is_fixed_up && display_item_index <= last_item_index)) {
-                line_str = bm_cairo_entry_message(items[display_item_index]->text, highlighted, menu->event_feedback, i, count);
+                line_str = bm_cairo_entry_message(bm_menu_get_item_display_text(menu, items[display_item_index]), highlighted, menu->event_feedback, i, count);
             }
 
             if (menu->prefix && highlighted) {
@@ -525,7 +527,8 @@ bm_cairo_paint(struct cairo *cairo, uint32_t width, uint32_t max_height, struct
             uint32_t hpadding = (menu->hpadding == 0 ? 2 : menu->hpadding);
             paint.pos = (struct pos){ cl + (hpadding/2), vpadding + border_size };
             paint.box = (struct box){ hpadding/2, 1.5 * hpadding, vpadding, -vpadding, 0, height };
-            bm_cairo_draw_line(cairo, &paint, &result, "%s", (items[i]->text ? items[i]->text : ""));
+            const char *text = bm_menu_get_item_display_text(menu, items[i]);
+            bm_cairo_draw_line(cairo, &paint, &result, "%s", (text ? text : ""));
             cl += result.x_advance + (0.5 * hpadding);
             out_result->displayed += (cl < width);
             out_result->height = fmax(out_result->height, result.height);
@@ -583,7 +586,11 @@ bm_cairo_paint(struct cairo *cairo, uint32_t width, uint32_t max_height, struct
 
     if (menu->counter) {
         char counter[128];
-        snprintf(counter, sizeof(counter), "[%u/%u]", filtered_item_count, total_item_count);
+        if (filtered_item_count == UINT32_MAX) {
+            snprintf(counter, sizeof(counter), "[-/%u]", total_item_count);
+        } else {
+            snprintf(counter, sizeof(counter), "[%u/%u]", filtered_item_count, total_item_count);
+        }
         bm_pango_get_text_extents(cairo, &paint, &result, "%s", counter);
 
         bm_cairo_color_from_menu_color(menu, BM_COLOR_ITEM_FG, &paint.fg);
@@ -2,6 +2,7 @@
 #include <wchar.h>
 #include <signal.h>
 #include <unistd.h>
+#include <poll.h>
 #include <string.h>
 #include <stdlib.h>
 #include <locale.h>
@@ -248,10 +249,11 @@ render(struct bm_menu *menu)
             bool highlighted = (items[i] == bm_menu_get_highlighted_item(menu));
             int32_t color = (highlighted ? 2 : (bm_menu_item_is_selected(menu, items[i]) ? 1 : 0));
 
+            const char *text = bm_menu_get_item_display_text(menu, items[i]);
             if (menu->prefix && highlighted) {
-                draw_line(color, 1 + cl++, "%*s%s %s", offset_x, "", menu->prefix, (items[i]->text ? items[i]->text : ""));
+                draw_line(color, 1 + cl++, "%*s%s %s", offset_x, "", menu->prefix, (text ? text : ""));
             } else {
-                draw_line(color, 1 + cl++, "%*s%s%s", offset_x + prefix_x, "", (menu->prefix ? " " : ""), (items[i]->text ? items[i]->text : ""));
+                draw_line(color, 1 + cl++, "%*s%s%s", offset_x + prefix_x, "", (menu->prefix ? " " : ""), (text ? text : ""));
             }
 
         }
@@ -292,7 +294,6 @@ get_displayed_count(const struct bm_menu *menu)
 static enum bm_key
 poll_key(const struct bm_menu *menu, uint32_t *unicode)
 {
-    (void)menu;
     assert(unicode);
     *unicode = 0;
     curses.polled_once = true;
@@ -300,7 +301,24 @@ poll_key(const struct bm_menu *menu, uint32_t *unicode)
     if (!curses.stdscreen || curses.should_terminate)
         return BM_KEY_NONE;
 
-    get_wch((wint_t*)unicode);
+    /* don't block while filtering continues in the background of input */
+    const bool pending = bm_menu_is_filter_pending(menu);
+
+    /* wake up for items pushed by producer threads as well */
+    if (!pending && menu->incoming.wake[0] >= 0) {
+        struct pollfd fds[2] = {
+            { .fd = STDIN_FILENO, .events = POLLIN },
+            { .fd = menu->incoming.wake[0], .events = POLLIN },
+        };
+
+        if (poll(fds, 2, -1) <= 0 || !(fds[0].revents & POLLIN))
+            return BM_KEY_NONE;
+    }
+
+    timeout(pending ? 0 : -1);
+
+    if (get_wch((wint_t*)unicode) == ERR)
+        return BM_KEY_NONE;
 
     switch (*unicode) {
 #if KEY_RESIZE
@@ -374,6 +392,15 @@ poll_key(const struct bm_menu *menu, uint32_t *unicode)
         case 353: /* S-Tab */
             return BM_KEY_SHIFT_TAB;
 
+        case 15: /* C-o */
+            return BM_KEY_SELECT_ALL;
+
+        case 24: /* C-x */
+            return BM_KEY_INVERT_SELECTION;
+
+        case 17: /* C-q */
+            return BM_KEY_CLEAR_SELECTION;
+
         case 18: /* C-r */
             return BM_KEY_CONTROL_RETURN;
 
@@ -24,15 +24,15 @@ render_windows_if_pending(struct bm_menu *menu, struct wayland *wayland) {
 }
 
 static bool
-wait_for_events(struct wayland *wayland) {
+wait_for_events(struct wayland *wayland, int timeout) {
     wl_display_dispatch_pending(wayland->display);
 
     if (wl_display_flush(wayland->display) < 0 && errno != EAGAIN)
         return false;
 
     struct epoll_event ep[16];
-    uint32_t num = epoll_wait(efd, ep, 16, -1);
-    for (uint32_t i = 0; i < num; ++i) {
+    int num = epoll_wait(efd, ep, 16, timeout);
+    for (int i = 0; i < num; ++i) {
         if (ep[i].data.ptr == &wayland->fds.display) {
             if (ep[i].events & EPOLLERR || ep[i].events & EPOLLHUP ||
                ((ep[i].events & EPOLLIN) && wl_display_dispatch(wayland->display) < 0))
@@ -69,7 +69,8 @@ render(struct bm_menu *menu)
     struct wayland *wayland = menu->renderer->internal;
 
     schedule_windows_render_if_dirty(menu, wayland);
-    if (!wait_for_events(wayland))
+    /* don't block while filtering continues in the background of input */
+    if (!wait_for_events(wayland, (bm_menu_is_filter_pending(menu) ? 0 : -1)))
         return false;
     render_windows_if_pending(menu, wayland);
 
@@ -176,7 +177,13 @@ poll_key(const struct bm_menu *menu, unsigned int *unicode)
             return (mods & MOD_CTRL ? BM_KEY_RIGHT : BM_KEY_UNICODE);
 
         case XKB_KEY_a:
-            return (mods & MOD_CTRL ? BM_KEY_HOME : BM_KEY_UNICODE);
+            return (mods & MOD_CTRL ? BM_KEY_HOME : (mods & MOD_ALT ? BM_KEY_SELECT_ALL : BM_KEY_UNICODE));
+
+        case XKB_KEY_i:
+            return (mods & MOD_ALT ? BM_KEY_INVERT_SELECTION : BM_KEY_UNICODE);
+
+        case XKB_KEY_x:
+            return (mods & MOD_ALT ? BM_KEY_CLEAR_SELECTION : BM_KEY_UNICODE);
 
         case XKB_KEY_e:
             return (mods & MOD_CTRL ? BM_KEY_END : BM_KEY_UNICODE);
@@ -601,6 +608,24 @@ set_monitor_name(const struct bm_menu *menu, char *monitor_name)
     }
 }
 
+static size_t
+get_memory_usage(const struct bm_menu *menu)
+{
+    struct wayland *wayland = menu->renderer->internal;
+    assert(wayland);
+
+    size_t size = 0;
+    struct window *window;
+    wl_list_for_each(window, &wayland->windows, link) {
+        for (int32_t i = 0; i < 2; ++i) {
+            if (window->buffers[i].buffer)
+                size += (size_t)window->buffers[i].width * window->buffers[i].height * 4;
+        }
+    }
+
+    return size;
+}
+
 static void
 destructor(struct bm_menu *menu)
 {
@@ -617,6 +642,8 @@ destructor(struct bm_menu *menu)
     if (wayland->display) {
         epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.repeat, NULL);
         epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.display, NULL);
+        if (menu->incoming.wake[0] >= 0)
+            epoll_ctl(efd, EPOLL_CTL_DEL, menu->incoming.wake[0], NULL);
         close(wayland->fds.repeat);
         wl_display_flush(wayland->display);
         wl_display_disconnect(wayland->display);
@@ -666,6 +693,14 @@ constructor(struct bm_menu *menu)
     ep2.events = EPOLLIN;
     ep2.data.ptr = &wayland->fds.repeat;
     epoll_ctl(efd, EPOLL_CTL_ADD, wayland->fds.repeat, &ep2);
+
+    /* only wakes up the loop, pushed items are applied by bm_menu_run_with_key */
+    if (menu->incoming.wake[0] >= 0) {
+        struct epoll_event ep3;
+        ep3.events = EPOLLIN;
+        ep3.data.ptr = NULL;
+        epoll_ctl(efd, EPOLL_CTL_ADD, menu->incoming.wake[0], &ep3);
+    }
     return true;
 
 fail:
@@ -693,6 +728,7 @@ register_renderer(struct render_api *api)
     api->set_overlap = set_overlap;
     api->set_monitor = set_monitor;
     api->set_monitor_name = set_monitor_name;
+    api->get_memory_usage = get_memory_usage;
     api->priorty = BM_PRIO_GUI;
     api->version = BM_PLUGIN_VERSION;
     return "wayland";
@@ -4,6 +4,7 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
 #include <X11/Xutil.h>
 
 static bool
@@ -14,6 +15,17 @@ render(struct bm_menu *menu)
     bm_x11_window_render(&x11->window, menu);
     XFlush(x11->display);
 
+    /* don't block while filtering continues in the background of input, or when items are pushed */
+    if (!XPending(x11->display)) {
+        struct pollfd fds[2] = {
+            { .fd = ConnectionNumber(x11->display), .events = POLLIN },
+            { .fd = menu->incoming.wake[0], .events = POLLIN },
+        };
+
+        if (poll(fds, 2, (bm_menu_is_filter_pending(menu) ? 0 : -1)) <= 0 || !(fds[0].revents & POLLIN))
+            return true;
+    }
+
     XEvent ev;
     if (XNextEvent(x11->display, &ev) || XFilterEvent(&ev, x11->window.drawable))
         return true;
@@ -132,7 +144,13 @@ poll_key(const struct bm_menu *menu, unsigned int *unicode)
             return (mods & MOD_CTRL ? BM_KEY_RIGHT : BM_KEY_UNICODE);
 
         case XK_a:
-            return (mods & MOD_CTRL ? BM_KEY_HOME : BM_KEY_UNICODE);
+            return (mods & MOD_CTRL ? BM_KEY_HOME : (mods & MOD_ALT ? BM_KEY_SELECT_ALL : BM_KEY_UNICODE));
+
+        case XK_i:
+            return (mods & MOD_ALT ? BM_KEY_INVERT_SELECTION : BM_KEY_UNICODE);
+
+        case XK_x:
+            return (mods & MOD_ALT ? BM_KEY_CLEAR_SELECTION : BM_KEY_UNICODE);
 
         case XK_e:
             return (mods & MOD_CTRL ? BM_KEY_END : BM_KEY_UNICODE);
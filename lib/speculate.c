@@ -0,0 +1,318 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <pthread.h>
+
+/**
+ * Upper bound of candidates sampled when building the next byte histogram.
+ */
+#define SAMPLE_LIMIT 65536
+
+/**
+ * Speculatively filtered result set for one possible next filter.
+ */
+struct slot {
+    /**
+     * Filter text this result set was produced for.
+     */
+    char *filter;
+
+    /**
+     * Filtered items, owned by the slot until taken.
+     */
+    struct bm_item **items;
+
+    /**
+     * Number of filtered items.
+     */
+    uint32_t count;
+
+    /**
+     * Set once the worker has published the result.
+     */
+    bool ready;
+};
+
+/**
+ * Speculation state of a bm_menu instance.
+ *
+ * Everything except the slots is written only by the menu thread while the
+ * worker is not running. Slots are guarded by the mutex.
+ */
+struct speculation {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+
+    /**
+     * Whether thread has been started and not yet joined.
+     */
+    bool running;
+
+    /**
+     * Tells the worker to give up as soon as possible.
+     */
+    bool cancel;
+
+    /**
+     * Filter the candidates were produced by, "" for unfiltered items.
+     */
+    char *base;
+
+    /**
+     * Filter mode the results are valid for.
+     */
+    enum bm_filter_mode mode;
+
+    /**
+     * Items the worker filters. Points into menu owned list,
+     * so the list must not change before bm_speculate_reset.
+     */
+    struct bm_item **candidates;
+    uint32_t ncandidates;
+
+    /**
+     * Column store of the candidates, or **NULL**.
+     */
+    const struct columns *columns;
+
+    /**
+     * Field layout of the menu, only changed while the worker is not running.
+     */
+    const struct fields *fields;
+
+    struct slot slots[BM_SPECULATE_SLOTS];
+};
+
+static void
+free_slots(struct speculation *spec)
+{
+    for (uint32_t i = 0; i < BM_SPECULATE_SLOTS; ++i) {
+        free(spec->slots[i].filter);
+        free(spec->slots[i].items);
+    }
+
+    memset(spec->slots, 0, sizeof(spec->slots));
+}
+
+/**
+ * Find the bytes most likely typed next.
+ *
+ * When the last token of the filter is non-empty, the byte following its first
+ * occurrence in each candidate is counted. Otherwise every distinct byte of the
+ * candidate counts, since the next token may match anywhere.
+ *
+ * @param spec Speculation state.
+ * @param out_bytes Array where the most likely bytes are stored, most likely first.
+ * @return Number of bytes stored to out_bytes.
+ */
+static uint32_t
+likely_next_bytes(struct speculation *spec, char out_bytes[BM_SPECULATE_SLOTS])
+{
+    const bool fold = (spec->mode == BM_FILTER_MODE_DMENU_CASE_INSENSITIVE);
+    char* (*fstrstr)(const char *a, const char *b) = (fold ? bm_strupstr : strstr);
+
+    const char *token = strrchr(spec->base, ' ');
+    token = (token ? token + 1 : spec->base);
+
+    uint32_t histogram[256] = {0};
+    struct fccursor cursor = {0};
+    const uint32_t step = (spec->ncandidates > SAMPLE_LIMIT ? spec->ncandidates / SAMPLE_LIMIT : 1);
+    for (uint32_t i = 0; i < spec->ncandidates && !__atomic_load_n(&spec->cancel, __ATOMIC_RELAXED); i += step) {
+        const char *text = fccursor_text(&cursor, spec->candidates[i]);
+        if (!text)
+            continue;
+
+        if (*token) {
+            const char *match;
+            if ((match = fstrstr(text, token)) && match[strlen(token)])
+                histogram[(unsigned char)(fold ? tolower(match[strlen(token)]) : match[strlen(token)])]++;
+        } else {
+            bool seen[256] = {0};
+            for (const unsigned char *s = (const unsigned char*)text; *s; ++s) {
+                unsigned char c = (fold ? tolower(*s) : *s);
+                if (!seen[c])
+                    histogram[c] += (seen[c] = true);
+            }
+        }
+    }
+
+    fccursor_release(&cursor);
+
+    uint32_t n = 0;
+    for (; n < BM_SPECULATE_SLOTS; ++n) {
+        int32_t best = -1;
+        for (int32_t c = '!'; c <= '~'; ++c) {
+            if (histogram[c] && (best < 0 || histogram[c] > histogram[best]))
+                best = c;
+        }
+
+        if (best < 0)
+            break;
+
+        out_bytes[n] = best;
+        histogram[best] = 0;
+    }
+
+    return n;
+}
+
+static void*
+worker(void *arg)
+{
+    struct speculation *spec = arg;
+
+    char bytes[BM_SPECULATE_SLOTS];
+    const uint32_t nbytes = likely_next_bytes(spec, bytes);
+    const size_t len = strlen(spec->base);
+
+    for (uint32_t i = 0; i < nbytes && !__atomic_load_n(&spec->cancel, __ATOMIC_RELAXED); ++i) {
+        char *filter;
+        if (!(filter = calloc(1, len + 2)))
+            break;
+
+        memcpy(filter, spec->base, len);
+        filter[len] = bytes[i];
+
+        uint32_t count;
+        struct bm_item **items = bm_filter_items(spec->mode, spec->fields, filter, spec->candidates, spec->ncandidates, spec->columns, &spec->cancel, &count);
+
+        if (!items && count == 0 && __atomic_load_n(&spec->cancel, __ATOMIC_RELAXED)) {
+            free(filter);
+            break;
+        }
+
+        pthread_mutex_lock(&spec->mutex);
+        spec->slots[i] = (struct slot){ .filter = filter, .items = items, .count = count, .ready = true };
+        pthread_mutex_unlock(&spec->mutex);
+    }
+
+    return NULL;
+}
+
+void
+bm_speculate_reset(struct bm_menu *menu)
+{
+    assert(menu);
+
+    struct speculation *spec;
+    if (!(spec = menu->speculation))
+        return;
+
+    if (spec->running) {
+        __atomic_store_n(&spec->cancel, true, __ATOMIC_RELAXED);
+        pthread_join(spec->thread, NULL);
+        spec->running = false;
+    }
+
+    free_slots(spec);
+    free(spec->base);
+    spec->base = NULL;
+    spec->candidates = NULL;
+    spec->ncandidates = 0;
+    spec->columns = NULL;
+    spec->cancel = false;
+}
+
+void
+bm_speculate_start(struct bm_menu *menu, const char *base, struct bm_item **candidates, uint32_t count, const struct columns *columns)
+{
+    assert(menu && base);
+
+    struct speculation *spec = menu->speculation;
+    if (spec && spec->base && spec->mode == menu->filter_mode && !strcmp(spec->base, base))
+        return;
+
+    bm_speculate_reset(menu);
+
+    /* only built-in filters are known to be safe to run on another thread */
+    if (count < BM_SPECULATE_MIN_ITEMS || !candidates || menu->filter_engine)
+        return;
+
+    if (!spec) {
+        if (!(spec = calloc(1, sizeof(struct speculation))))
+            return;
+
+        pthread_mutex_init(&spec->mutex, NULL);
+        menu->speculation = spec;
+    }
+
+    if (!(spec->base = calloc(1, strlen(base) + 1)))
+        return;
+
+    strcpy(spec->base, base);
+    spec->mode = menu->filter_mode;
+    spec->candidates = candidates;
+    spec->ncandidates = count;
+    spec->columns = columns;
+    spec->fields = &menu->fields;
+    spec->running = !pthread_create(&spec->thread, NULL, worker, spec);
+}
+
+bool
+bm_speculate_take(struct bm_menu *menu, struct bm_item ***out_items, uint32_t *out_nmemb)
+{
+    assert(menu && out_items && out_nmemb);
+
+    struct speculation *spec = menu->speculation;
+    if (!spec || !spec->base || !menu->filter || spec->mode != menu->filter_mode)
+        return false;
+
+    if (strcmp(spec->base, (menu->old_filter ? menu->old_filter : "")))
+        return false;
+
+    bool found = false;
+    pthread_mutex_lock(&spec->mutex);
+    for (uint32_t i = 0; i < BM_SPECULATE_SLOTS; ++i) {
+        struct slot *slot = &spec->slots[i];
+        if (!slot->ready || strcmp(slot->filter, menu->filter))
+            continue;
+
+        *out_items = slot->items;
+        *out_nmemb = slot->count;
+        slot->items = NULL;
+        slot->ready = false;
+        found = true;
+        break;
+    }
+    pthread_mutex_unlock(&spec->mutex);
+
+    return found;
+}
+
+size_t
+bm_speculate_memory_usage(const struct bm_menu *menu)
+{
+    assert(menu);
+
+    struct speculation *spec;
+    if (!(spec = menu->speculation))
+        return 0;
+
+    size_t size = sizeof(struct speculation);
+    pthread_mutex_lock(&spec->mutex);
+    for (uint32_t i = 0; i < BM_SPECULATE_SLOTS; ++i) {
+        if (spec->slots[i].items)
+            size += sizeof(struct bm_item*) * spec->slots[i].count;
+    }
+    pthread_mutex_unlock(&spec->mutex);
+
+    return size;
+}
+
+void
+bm_speculate_free(struct bm_menu *menu)
+{
+    assert(menu);
+
+    if (!menu->speculation)
+        return;
+
+    bm_speculate_reset(menu);
+    pthread_mutex_destroy(&menu->speculation->mutex);
+    free(menu->speculation);
+    menu->speculation = NULL;
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -0,0 +1,213 @@
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Iterate text of item, every field of items split into fields.
+ */
+static const char*
+text_part(struct fccursor *cursor, const struct bm_item *item, uint32_t part)
+{
+    if (item->flags & BM_ITEM_FIELDS)
+        return bm_item_get_field(item, part);
+
+    if (part > 0)
+        return NULL;
+
+    const char *text = fccursor_text(cursor, item);
+    return (text ? text : "");
+}
+
+/**
+ * FNV-1a over the text of the item, fields are hashed with their terminators.
+ */
+static uint64_t
+text_hash(struct fccursor *cursor, const struct bm_item *item)
+{
+    uint64_t hash = 14695981039346656037llu;
+
+    const char *part;
+    for (uint32_t i = 0; (part = text_part(cursor, item, i)); ++i) {
+        const unsigned char *s = (const unsigned char*)part;
+        do {
+            hash = (hash ^ *s) * 1099511628211llu;
+        } while (*s++);
+    }
+
+    return hash;
+}
+
+static bool
+same_text(const struct bm_item *a, const struct bm_item *b)
+{
+    /* the other item may be front coded too, so it gets a cursor of its own */
+    struct fccursor ca = {0}, cb = {0};
+
+    const char *pa, *pb;
+    bool same = true;
+    for (uint32_t i = 0; same; ++i) {
+        pa = text_part(&ca, a, i);
+        pb = text_part(&cb, b, i);
+        same = (pa && pb ? !strcmp(pa, pb) : pa == pb);
+
+        if (!pa || !pb)
+            break;
+    }
+
+    fccursor_release(&ca);
+    fccursor_release(&cb);
+    return same;
+}
+
+static bool
+textset_grow(struct textset *set)
+{
+    struct textset grown = { .size = (set->size ? set->size * 2 : 1024) };
+    if (!(grown.items = calloc(grown.size, sizeof(void*))) || !(grown.hashes = calloc(grown.size, sizeof(uint64_t)))) {
+        free(grown.items);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < set->size; ++i) {
+        if (!set->items[i])
+            continue;
+
+        uint32_t j = (uint32_t)(set->hashes[i] >> 32) & (grown.size - 1);
+        for (; grown.items[j]; j = (j + 1) & (grown.size - 1));
+        grown.items[j] = set->items[i];
+        grown.hashes[j] = set->hashes[i];
+    }
+
+    grown.count = set->count;
+    textset_release(set);
+    *set = grown;
+    return true;
+}
+
+/**
+ * Insert item unless an item with the same text is in the set already.
+ *
+ * @param set textset to insert to.
+ * @param item Item to insert.
+ * @param hash Hash of the item's text.
+ * @param out_inserted Reference to bool, true if item was inserted, false if it is a duplicate.
+ * @return true on success, false if out of memory.
+ */
+static bool
+textset_insert(struct textset *set, const struct bm_item *item, uint64_t hash, bool *out_inserted)
+{
+    /* keep load factor at most 1/2 */
+    if ((set->count + 1) * 2 > set->size && !textset_grow(set))
+        return false;
+
+    const uint32_t mask = set->size - 1;
+    uint32_t i = (uint32_t)(hash >> 32) & mask;
+    for (; set->items[i]; i = (i + 1) & mask) {
+        if (set->hashes[i] == hash && same_text(set->items[i], item)) {
+            *out_inserted = false;
+            return true;
+        }
+    }
+
+    set->items[i] = item;
+    set->hashes[i] = hash;
+    set->count++;
+    *out_inserted = true;
+    return true;
+}
+
+static void
+textset_clear(struct textset *set)
+{
+    if (!set->count)
+        return;
+
+    memset(set->items, 0, sizeof(void*) * set->size);
+    set->count = 0;
+}
+
+void
+textset_release(struct textset *set)
+{
+    assert(set);
+    free(set->items);
+    free(set->hashes);
+    memset(set, 0, sizeof(struct textset));
+}
+
+/**
+ * Drop items appended from index first on whose text equals an earlier item, keeping the order of the rest.
+ * Dropped items are freed. The column store is compacted along if it covers the appended items.
+ *
+ * @param menu bm_menu instance whose items to check.
+ * @param first Index of the first appended item.
+ */
+void
+unique_tail(struct bm_menu *menu, uint32_t first)
+{
+    assert(menu && first <= menu->items.count);
+
+    struct textset *set = &menu->unique.set;
+    struct bm_item **items = (struct bm_item**)menu->items.items;
+    struct fccursor cursor = {0};
+
+    /* items changed some other way since the set was built, it may refer to freed items */
+    if (menu->unique.covered != first) {
+        textset_clear(set);
+        menu->unique.covered = UINT32_MAX;
+
+        for (uint32_t i = 0; i < first; ++i) {
+            bool inserted;
+            if (!textset_insert(set, items[i], text_hash(&cursor, items[i]), &inserted))
+                goto out;
+        }
+    }
+
+    struct columns *columns = &menu->columns;
+    const bool compact_columns = (columns->count == menu->items.count);
+    if (columns->count > first && !compact_columns)
+        columns->count = first;
+
+    bool complete = true;
+    uint32_t kept = first;
+    for (uint32_t i = first; i < menu->items.count; ++i) {
+        bool inserted = true;
+        if (complete && !textset_insert(set, items[i], text_hash(&cursor, items[i]), &inserted))
+            complete = false;
+
+        if (!inserted) {
+            bm_item_free(items[i]);
+            continue;
+        }
+
+        if (kept != i) {
+            items[kept] = items[i];
+
+            if (compact_columns)
+                columns_move(columns, kept, i);
+        }
+
+        ++kept;
+    }
+
+    menu->items.count = kept;
+
+    if (compact_columns)
+        columns->count = kept;
+
+    /* after running out of memory the rest is kept unchecked, and the set is rebuilt next time */
+    menu->unique.covered = (complete ? kept : UINT32_MAX);
+
+out:
+    fccursor_release(&cursor);
+}
+
+size_t
+unique_memory_usage(const struct bm_menu *menu)
+{
+    assert(menu);
+    return ((size_t)sizeof(void*) + sizeof(uint64_t)) * menu->unique.set.size;
+}
+
+/* vim: set ts=8 sw=4 tw=0 :*/
@@ -406,10 +406,151 @@ bm_menu_item_is_selected(const struct bm_menu *menu, const struct bm_item *item)
     assert(menu);
     assert(item);
 
-    uint32_t i, count;
-    struct bm_item **items = bm_menu_get_selected_items(menu, &count);
-    for (i = 0; i < count && items[i] != item; ++i);
-    return (i < count);
+    return ptrmap_get(&menu->selected, item, NULL);
+}
+
+static uint32_t
+ptrmap_slot(const struct ptrmap *map, const void *key)
+{
+    /* fibonacci hashing, low bits of pointers are mostly zero due to alignment */
+    return (uint32_t)(((uint64_t)(uintptr_t)key * 11400714819323198485llu) >> 32) & (map->size - 1);
+}
+
+static bool
+ptrmap_grow(struct ptrmap *map)
+{
+    struct ptrmap grown = { .size = (map->size ? map->size * 2 : 16) };
+    if (!(grown.keys = calloc(grown.size, sizeof(void*))) || !(grown.values = calloc(grown.size, sizeof(uint32_t)))) {
+        free(grown.keys);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < map->size; ++i) {
+        if (map->keys[i])
+            ptrmap_put(&grown, map->keys[i], map->values[i]);
+    }
+
+    ptrmap_release(map);
+    *map = grown;
+    return true;
+}
+
+/**
+ * Insert key or replace value of existing key.
+ * Replacing never allocates, so it can not fail.
+ *
+ * @param map ptrmap to insert to.
+ * @param key Non **NULL** pointer.
+ * @param value Value for the key.
+ * @return true on success, false if out of memory.
+ */
+bool
+ptrmap_put(struct ptrmap *map, const void *key, uint32_t value)
+{
+    assert(map && key);
+
+    uint32_t i = 0;
+    if (map->size) {
+        i = ptrmap_slot(map, key);
+        for (; map->keys[i] && map->keys[i] != key; i = (i + 1) & (map->size - 1));
+    }
+
+    /* keep load factor at most 1/2, replacing value of existing key never fails */
+    if (!map->size || !map->keys[i]) {
+        if ((map->count + 1) * 2 > map->size) {
+            if (!ptrmap_grow(map))
+                return false;
+
+            i = ptrmap_slot(map, key);
+            for (; map->keys[i]; i = (i + 1) & (map->size - 1));
+        }
+
+        map->count++;
+    }
+
+    map->keys[i] = key;
+    map->values[i] = value;
+    return true;
+}
+
+/**
+ * Look up key.
+ *
+ * @param map ptrmap to look from.
+ * @param key Pointer to look up.
+ * @param out_value Optional reference where value of the key is stored.
+ * @return true if key was found.
+ */
+bool
+ptrmap_get(const struct ptrmap *map, const void *key, uint32_t *out_value)
+{
+    assert(map);
+
+    if (!map->count || !key)
+        return false;
+
+    uint32_t i = ptrmap_slot(map, key);
+    for (; map->keys[i] && map->keys[i] != key; i = (i + 1) & (map->size - 1));
+
+    if (!map->keys[i])
+        return false;
+
+    if (out_value)
+        *out_value = map->values[i];
+
+    return true;
+}
+
+/**
+ * Remove key.
+ * Following keys of the probe sequence are shifted back, so no tombstones are needed.
+ *
+ * @param map ptrmap to remove from.
+ * @param key Pointer to remove.
+ * @return true if key was found and removed.
+ */
+bool
+ptrmap_remove(struct ptrmap *map, const void *key)
+{
+    assert(map);
+
+    if (!map->count || !key)
+        return false;
+
+    const uint32_t mask = map->size - 1;
+    uint32_t i = ptrmap_slot(map, key);
+    for (; map->keys[i] && map->keys[i] != key; i = (i + 1) & mask);
+
+    if (!map->keys[i])
+        return false;
+
+    for (uint32_t j = (i + 1) & mask; map->keys[j]; j = (j + 1) & mask) {
+        /* move key at j into the hole at i, unless its home slot lies cyclically in (i, j] */
+        uint32_t home = ptrmap_slot(map, map->keys[j]);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->keys[i] = map->keys[j];
+            map->values[i] = map->values[j];
+            i = j;
+        }
+    }
+
+    map->keys[i] = NULL;
+    map->count--;
+    return true;
+}
+
+/**
+ * Release memory of ptrmap, leaving it empty.
+ *
+ * @param map ptrmap to release.
+ */
+void
+ptrmap_release(struct ptrmap *map)
+{
+    assert(map);
+    free(map->keys);
+    free(map->values);
+    *map = (struct ptrmap){0};
 }
 
 /* vim: set ts=8 sw=4 tw=0 :*/
@@ -194,9 +194,9 @@ static void toggle_item_selection(struct bm_menu *menu){
     struct bm_item *highlighted = bm_menu_get_highlighted_item(menu);
     if (highlighted){
         if(!bm_menu_item_is_selected(menu, highlighted)){
-            list_add_item(&menu->selection, highlighted);
+            selection_add(menu, highlighted);
         } else {
-            list_remove_item(&menu->selection, highlighted);
+            selection_remove(menu, highlighted);
         }
     }
 }